@@ -0,0 +1,9 @@
+#ifndef BASELINE_DEVICE_H
+#define BASELINE_DEVICE_H
+
+// 実機（AtomS3）での比較対象（任意）
+// リポジトリには実機の計測値を含めない（空のまま = 比較しない）
+// 比較したいときは、変更前に env:bench_atoms3 の出力末尾「Baseline:」以降の行をここに貼ってから変更後に計測する
+static const char BENCH_BASELINE_DEVICE[] = "";
+
+#endif // BASELINE_DEVICE_H
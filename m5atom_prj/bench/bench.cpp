@@ -0,0 +1,251 @@
+#include "bench.h"
+
+#include <new>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef ARDUINO
+#include <Arduino.h>
+#include <esp_timer.h>
+#else
+#include <chrono>
+#endif
+
+#define BENCH_MIN_DURATION_NS 20000000ULL  // 1回の計測は最低20ms
+#define BENCH_REPEATS 5                    // 計測を繰り返して最速値を採用（割り込み等のノイズ対策）
+#define BENCH_RECHECKS 2                   // 悪化と判定した項目の再計測回数
+
+static double regressionRatio = 1.10;      // ベースラインより10%以上遅ければ悪化とみなす
+static double noiseFloorNs = 50.0;         // ただし差がこれ未満なら計測の揺らぎとみなす（数ns〜数十nsの項目は割合だけでは判定できない）
+
+volatile uint32_t benchAllocCount = 0;
+
+static BenchResult results[BENCH_MAX_RESULTS];
+static int resultCount = 0;
+
+// --- ヒープ確保の計数 ---
+
+#ifdef BENCH_WRAP_MALLOC
+// 実機ではリンカの--wrapでmalloc系を数える（Arduino Stringはmalloc/reallocを直接使い、
+// operator newもmallocを経由するのでこれで全て数えられる）
+extern "C" {
+void* __real_malloc(size_t size);
+void* __real_realloc(void* p, size_t size);
+void* __real_calloc(size_t n, size_t size);
+
+void* __wrap_malloc(size_t size) {
+  benchAllocCount++;
+  return __real_malloc(size);
+}
+
+void* __wrap_realloc(void* p, size_t size) {
+  benchAllocCount++;
+  return __real_realloc(p, size);
+}
+
+void* __wrap_calloc(size_t n, size_t size) {
+  benchAllocCount++;
+  return __real_calloc(n, size);
+}
+}
+#else
+// ネイティブではoperator newを置き換えて数える
+void* operator new(size_t size) {
+  benchAllocCount++;
+  void* p = malloc(size);
+  if (p == nullptr) {
+    abort();
+  }
+  return p;
+}
+
+void* operator new[](size_t size) {
+  benchAllocCount++;
+  void* p = malloc(size);
+  if (p == nullptr) {
+    abort();
+  }
+  return p;
+}
+
+void operator delete(void* p) noexcept {
+  free(p);
+}
+
+void operator delete[](void* p) noexcept {
+  free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+  free(p);
+}
+
+void operator delete[](void* p, size_t) noexcept {
+  free(p);
+}
+#endif
+
+// --- 計時 ---
+
+static uint64_t nowNs() {
+#ifdef ARDUINO
+  return (uint64_t)esp_timer_get_time() * 1000ULL;
+#else
+  return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+void benchPrintf(const char* fmt, ...) {
+  char line[160];
+  va_list args;
+  va_start(args, fmt);
+  vsnprintf(line, sizeof(line), fmt, args);
+  va_end(args);
+#ifdef ARDUINO
+  Serial.print(line);
+#else
+  fputs(line, stdout);
+#endif
+}
+
+// 1回あたりの時間[ns]とヒープ確保回数を計測
+static double measure(BenchFunc func, void* ctx, double* allocsPerOp) {
+  // ウォームアップ
+  func(ctx);
+
+  // 最低計測時間を超えるまで反復回数を倍々に増やす
+  uint64_t iterations = 1;
+  uint64_t elapsed = 0;
+  uint32_t allocs = 0;
+  while (true) {
+    uint32_t allocStart = benchAllocCount;
+    uint64_t start = nowNs();
+    for (uint64_t i = 0; i < iterations; i++) {
+      func(ctx);
+    }
+    elapsed = nowNs() - start;
+    allocs = benchAllocCount - allocStart;
+    if (elapsed >= BENCH_MIN_DURATION_NS || iterations >= (1ULL << 30)) {
+      break;
+    }
+    iterations *= 2;
+  }
+
+  // 同じ反復回数で繰り返し、最速値を採用
+  uint64_t best = elapsed;
+  for (int rep = 1; rep < BENCH_REPEATS; rep++) {
+    uint64_t start = nowNs();
+    for (uint64_t i = 0; i < iterations; i++) {
+      func(ctx);
+    }
+    uint64_t t = nowNs() - start;
+    if (t < best) {
+      best = t;
+    }
+  }
+
+  *allocsPerOp = (double)allocs / iterations;
+  return (double)best / iterations;
+}
+
+double benchRun(const char* name, BenchFunc func, void* ctx) {
+  double allocsPerOp;
+  double nsPerOp = measure(func, ctx, &allocsPerOp);
+  if (resultCount < BENCH_MAX_RESULTS) {
+    BenchResult& r = results[resultCount++];
+    r.name = name;
+    r.nsPerOp = nsPerOp;
+    r.allocsPerOp = allocsPerOp;
+    r.func = func;
+    r.ctx = ctx;
+  }
+  return nsPerOp;
+}
+
+static bool isSlower(double ns, double baseNs) {
+  return ns > baseNs * regressionRatio && ns - baseNs >= noiseFloorNs;
+}
+
+// ベースラインから該当項目を探す
+static bool findBaseline(const char* baselineText, const char* name, double* ns, double* allocs) {
+  if (baselineText == nullptr) {
+    return false;
+  }
+  size_t nameLen = strlen(name);
+  const char* line = baselineText;
+  while (*line != '\0') {
+    const char* end = strchr(line, '\n');
+    size_t lineLen = end ? (size_t)(end - line) : strlen(line);
+    if (lineLen > nameLen && strncmp(line, name, nameLen) == 0 && line[nameLen] == ' ') {
+      char values[64];
+      size_t valuesLen = lineLen - nameLen;
+      if (valuesLen >= sizeof(values)) {
+        valuesLen = sizeof(values) - 1;
+      }
+      memcpy(values, line + nameLen, valuesLen);
+      values[valuesLen] = '\0';
+      return sscanf(values, "%lf %lf", ns, allocs) == 2;
+    }
+    if (end == nullptr) {
+      break;
+    }
+    line = end + 1;
+  }
+  return false;
+}
+
+void benchSetThreshold(double percent) {
+  regressionRatio = 1.0 + percent / 100.0;
+}
+
+void benchSetNoiseFloor(double ns) {
+  noiseFloorNs = ns;
+}
+
+int benchReport(const char* baselineText) {
+  int regressions = 0;
+  benchPrintf("%-32s %12s %10s %12s %8s\n", "benchmark", "ns/op", "allocs/op", "base ns/op", "delta");
+  for (int i = 0; i < resultCount; i++) {
+    BenchResult& r = results[i];
+    double baseNs, baseAllocs;
+    if (findBaseline(baselineText, r.name, &baseNs, &baseAllocs) && baseNs > 0) {
+      for (int retry = 0; retry < BENCH_RECHECKS && isSlower(r.nsPerOp, baseNs); retry++) {
+        double allocsPerOp;
+        double ns = measure(r.func, r.ctx, &allocsPerOp);
+        if (ns < r.nsPerOp) {
+          r.nsPerOp = ns;
+        }
+      }
+      double delta = (r.nsPerOp / baseNs - 1.0) * 100.0;
+      bool slower = isSlower(r.nsPerOp, baseNs);
+      bool moreAllocs = r.allocsPerOp > baseAllocs + 0.001;
+      if (slower || moreAllocs) {
+        regressions++;
+      }
+      benchPrintf("%-32s %12.1f %10.2f %12.1f %+7.1f%%%s\n", r.name, r.nsPerOp, r.allocsPerOp,
+                  baseNs, delta, (slower || moreAllocs) ? " REGRESSION" : "");
+    } else {
+      benchPrintf("%-32s %12.1f %10.2f %12s %8s\n", r.name, r.nsPerOp, r.allocsPerOp, "-", "-");
+    }
+  }
+  if (baselineText == nullptr || baselineText[0] == '\0') {
+    benchPrintf("(no baseline given: regression check skipped)\n");
+  }
+  return regressions;
+}
+
+size_t benchFormatBaseline(char* buf, size_t cap) {
+  size_t pos = 0;
+  for (int i = 0; i < resultCount && pos < cap; i++) {
+    int n = snprintf(buf + pos, cap - pos, "%s %.1f %.2f\n",
+                     results[i].name, results[i].nsPerOp, results[i].allocsPerOp);
+    if (n < 0) {
+      break;
+    }
+    pos += (size_t)n;
+  }
+  return pos < cap ? pos : cap;
+}
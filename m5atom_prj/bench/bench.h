@@ -0,0 +1,53 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// マイクロベンチマークの計測ハーネス
+// ネイティブ（env:bench_native）と実機（env:bench_atoms3）の両方でビルドできる
+
+typedef void (*BenchFunc)(void* ctx);
+
+struct BenchResult {
+  const char* name;
+  double nsPerOp;
+  double allocsPerOp;
+  BenchFunc func;  // 悪化と判定した項目の再計測用
+  void* ctx;
+};
+
+#define BENCH_MAX_RESULTS 48
+
+// 計測して結果を記録する（1回あたりの時間・ヒープ確保回数、戻り値はns/op）
+// ctxはbenchReportで再計測するまで有効なものを渡す
+double benchRun(const char* name, BenchFunc func, void* ctx);
+
+// 悪化とみなす閾値[%]（デフォルト10%）
+void benchSetThreshold(double percent);
+
+// 悪化とみなす最小の差[ns]（デフォルト50ns、割合の閾値と両方を超えたら悪化）
+void benchSetNoiseFloor(double ns);
+
+// 記録した結果を表示（baselineTextがあれば比較する。nullptr・空文字列なら比較しない）
+// baselineTextは「名前 ns/op allocs/op」を1行ずつ並べたもの（benchFormatBaselineの出力と同じ形式）
+// 遅くなった項目は再計測して最速値で判定する（他のプロセス等による一時的な揺らぎ対策）
+// 戻り値：ベースラインより遅くなった・確保回数が増えた項目の数
+int benchReport(const char* baselineText);
+
+// 記録した結果をベースライン形式で書き出す（戻り値：書き込んだ文字数）
+size_t benchFormatBaseline(char* buf, size_t cap);
+
+// 出力（ネイティブはstdout、実機はSerial）
+void benchPrintf(const char* fmt, ...);
+
+// 計測対象の結果が最適化で消えないようにする
+template <typename T>
+inline void benchKeep(const T& value) {
+  asm volatile("" : : "g"(&value) : "memory");
+}
+
+// ヒープ確保回数（ネイティブはoperator new、実機はmalloc/realloc/calloc）
+extern volatile uint32_t benchAllocCount;
+
+#endif // BENCH_H
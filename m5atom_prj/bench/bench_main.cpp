@@ -0,0 +1,436 @@
+// タップ・ループごとに実行される処理のマイクロベンチマーク
+//
+// ネイティブ: pio run -e bench_native && .pio/build/bench_native/program
+//               [--baseline FILE] [--save FILE] [--threshold PERCENT] [--noise-ns NS]
+//             （比較は任意。ベースラインはマシン依存なので、変更前に --save bench/baseline_native.txt で各自記録する）
+// 実機:       pio run -e bench_atoms3 -t upload && pio device monitor
+//             （比較は任意。変更前の結果末尾のベースライン形式の行を bench/baseline_device.h に貼ると比較される）
+//
+// ベースラインを与えた場合のみ、閾値（デフォルト10%かつ50ns）以上遅い・ヒープ確保が増えた項目をREGRESSIONと表示する
+//
+// 最後に、カード認証付きのタップを模擬カードに対して実行し、計算時間の実測と通信時間の見積もり（sim_card.h）から
+// 検知のポーリング開始〜解錠判定、かざしてから解錠判定まで（ポーリング周期の待ちを含む最悪値）がそれぞれ予算内かを確認する
+// あわせて、模擬カードで再現した異常系（鍵違い・アプリなし・通信切れ）の判定を確認する（誤りがあれば失敗）
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bench.h"
+#include "access_core.h"
+#include "door_detector.h"
+#include "telemetry.h"
+#include "card_auth.h"
+#include "aes128.h"
+#include "sim_card.h"
+
+#ifdef ARDUINO
+#include <Arduino.h>
+#include "baseline_device.h"
+#endif
+
+// --- 登録カード表（10〜1000枚） ---
+
+#define MAX_CARDS 1000
+
+static char cardIdStorage[MAX_CARDS][CARD_ID_BUF_SIZE];
+static const char* cardIds[MAX_CARDS];
+
+static void buildCardTable() {
+  for (int i = 0; i < MAX_CARDS; i++) {
+    uint8_t idm[8] = { 0x01, 0x2E, 0x4C, 0x00, 0x00, 0x00, (uint8_t)(i >> 8), (uint8_t)i };
+    cardBytesToHex(idm, 8, cardIdStorage[i]);
+    cardIds[i] = cardIdStorage[i];
+  }
+}
+
+struct LookupCtx {
+  int count;
+  const char* id;
+};
+
+static void benchFindCard(void* p) {
+  LookupCtx* ctx = (LookupCtx*)p;
+  int index = findCardIndex(cardIds, ctx->count, ctx->id);
+  benchKeep(index);
+}
+
+// --- NFC ---
+
+static void benchHexFelica(void*) {
+  static const uint8_t idm[8] = { 0x01, 0x2E, 0x4C, 0xB5, 0x6A, 0x0F, 0x13, 0x9D };
+  char out[CARD_ID_BUF_SIZE];
+  cardBytesToHex(idm, 8, out);
+  benchKeep(out);
+}
+
+static void benchHexTypeA(void*) {
+  static const uint8_t uid[7] = { 0x04, 0xA2, 0x3B, 0x1A, 0x9F, 0x61, 0x80 };
+  char out[CARD_ID_BUF_SIZE];
+  cardBytesToHex(uid, 7, out);
+  benchKeep(out);
+}
+
+struct DebounceCtx {
+  CardDebouncer debouncer;
+  const char* id;
+  DebounceCtx() : debouncer(2000), id(nullptr) {}
+};
+
+static void benchSameCard(void* p) {
+  DebounceCtx* ctx = (DebounceCtx*)p;
+  bool repeat = ctx->debouncer.isRepeat(1, ctx->id, 1000);
+  benchKeep(repeat);
+}
+
+// --- コマンド・UDP ---
+
+static void benchParseCommand(void* p) {
+  const char* payload = (const char*)p;
+  LockCommand cmd = parseCommand(payload, strlen(payload));
+  benchKeep(cmd);
+}
+
+// processUdp相当：受信バッファへのコピー（udpControl.readの代わり）→ parseUdpPacket
+static void benchUdpPacket(void* p) {
+  const char* packet = (const char*)p;
+  char buffer[UDP_PACKET_BUF_SIZE];
+  int len = (int)strlen(packet);
+  memcpy(buffer, packet, len);
+  LockCommand cmd = parseUdpPacket(buffer, len, sizeof(buffer));
+  benchKeep(cmd);
+}
+
+// --- メッセージ構築（openDoor/closeDoor） ---
+
+static void benchOpenDoorMessages(void*) {
+  char logMsg[160];
+  char notificationMsg[160];
+  formatAccessLog(logMsg, sizeof(logMsg), true, ACCESS_NFC, "カード1");
+  formatAccessNotification(notificationMsg, sizeof(notificationMsg), true, ACCESS_NFC, "カード1");
+  benchKeep(logMsg);
+  benchKeep(notificationMsg);
+}
+
+static void benchCloseDoorMessages(void*) {
+  char logMsg[160];
+  char notificationMsg[160];
+  formatAccessLog(logMsg, sizeof(logMsg), false, ACCESS_AUTO, "");
+  formatAccessNotification(notificationMsg, sizeof(notificationMsg), false, ACCESS_AUTO, "");
+  benchKeep(logMsg);
+  benchKeep(notificationMsg);
+}
+
+// --- テレメトリ・ドア検知（タップ・ループごと） ---
+
+static void benchTelemetryCardEvent(void*) {
+  TelemetryEvent ev;
+  telemetryInitEvent(&ev, TEV_CARD_ACCEPTED);
+  ev.seq = 1234;
+  ev.bootId = 0x12345678;
+  ev.uptimeMs = 86400000;
+  ev.unixMs = 1760000000000ULL;
+  ev.cardType = 1;
+  ev.fields |= TF_UNIX_MS | TF_CARD_TYPE;
+  telemetrySetUidHex(&ev, "012E4CB56A0F139D");
+  uint8_t buf[64];
+  size_t n = telemetryEncode(ev, buf, sizeof(buf));
+  benchKeep(n);
+  benchKeep(buf);
+}
+
+struct DoorCtx {
+  DoorDetector detector;
+  unsigned long now;
+  uint16_t i;
+};
+
+static void benchDoorUpdate(void* p) {
+  DoorCtx* ctx = (DoorCtx*)p;
+  ctx->now += 45;
+  ctx->i++;
+  // 閉状態のノイズを含む測定値
+  uint16_t range = (ctx->i % 16 == 0) ? 90 : 30 + (ctx->i % 5);
+  bool changed = ctx->detector.update(ctx->now, range, 0, 3.0f);
+  benchKeep(changed);
+}
+
+// --- カード認証（AES） ---
+
+#define TAP_DETECT_BUDGET_US 100000  // 認証付きタップ：カードを見つけるポーリングの開始から解錠判定まで
+#define TAP_TOTAL_BUDGET_US  300000  // 認証付きタップ：かざしてから解錠判定まで（ポーリング周期の待ちを含む）
+
+static const uint8_t SIM_CARD_KEY[CARD_AUTH_KEY_SIZE] = {
+  0xA8, 0xDD, 0x63, 0xA3, 0xB8, 0x9D, 0x54, 0xB3, 0x7C, 0xA8, 0x02, 0x47, 0x3F, 0xDA, 0x91, 0x75
+};
+
+// 鍵違いのカード（UIDだけ複製したカードを想定）
+static const uint8_t SIM_WRONG_KEY[CARD_AUTH_KEY_SIZE] = {
+  0x00, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77, 0x88, 0x99, 0xAA, 0xBB, 0xCC, 0xDD, 0xEE, 0xFF
+};
+
+static void simRandom(uint8_t* out, size_t len) {
+  static uint32_t state = 0x9E3779B9;
+  for (size_t i = 0; i < len; i++) {
+    state = state * 1664525 + 1013904223;
+    out[i] = (uint8_t)(state >> 24);
+  }
+}
+
+static void benchAesCbc32(void*) {
+  uint8_t in[32] = { 0 };
+  uint8_t out[32];
+  uint8_t iv[AES128_BLOCK_SIZE] = { 0 };
+  Aes128 aes;
+  aes.setKey(SIM_CARD_KEY);
+  aes.encryptCbc(iv, in, out, sizeof(in));
+  benchKeep(out);
+}
+
+static struct TapCtx {
+  SimCard card;
+  CardAuthCredential creds[10];
+  const char* id;
+  CardAuthResult result;
+  double nsPerTap;
+  TapCtx() : card(SIM_CARD_KEY, 0), id(nullptr), result(CARD_AUTH_LINK_ERROR), nsPerTap(0) {}
+} tap;
+
+// processNfc相当：カード検知 → ID照合 → 認証情報の検索 → 模擬カードと認証 → メッセージ構築
+// （模擬カード側のAES処理も計算時間に含まれるので、見積もりとしては厳しめになる）
+static void benchTapWithAuth(void* p) {
+  TapCtx* ctx = (TapCtx*)p;
+  ctx->card.reset();
+  ctx->card.activate();
+  int index = findCardIndex(cardIds, 10, ctx->id);
+  const CardAuthCredential* cred = findCardCredential(ctx->creds, 10, ctx->id);
+  ctx->result = cardAuthenticate(*cred, SimCard::transceive, &ctx->card, simRandom);
+  char logMsg[160];
+  char notificationMsg[160];
+  formatAccessLog(logMsg, sizeof(logMsg), true, ACCESS_NFC, "カード1");
+  formatAccessNotification(notificationMsg, sizeof(notificationMsg), true, ACCESS_NFC, "カード1");
+  benchKeep(index);
+  benchKeep(logMsg);
+  benchKeep(notificationMsg);
+}
+
+// 戻り値：予算を超えた項目の数
+static int checkTapBudget() {
+  uint32_t cpuUs = (uint32_t)(tap.nsPerTap / 1000.0);
+  uint32_t activationUs = tap.card.getActivationUs();
+  uint32_t detectUs = cpuUs + activationUs + tap.card.getLinkUs();
+  uint32_t totalUs = tap.card.getPollWaitUs() + detectUs;
+  bool authOk = tap.result == CARD_AUTH_OK;
+  bool detectOk = authOk && detectUs <= TAP_DETECT_BUDGET_US;
+  bool totalOk = authOk && totalUs <= TAP_TOTAL_BUDGET_US;
+  benchPrintf("\n[Budget] poll to unlock with AES auth: cpu %lu us + activation %lu us + link %lu us (%d exchanges)"
+              " = %lu us / budget %lu us: %s (%s)\n",
+              (unsigned long)cpuUs, (unsigned long)activationUs, (unsigned long)tap.card.getLinkUs(),
+              tap.card.getExchanges(), (unsigned long)detectUs, (unsigned long)TAP_DETECT_BUDGET_US,
+              detectOk ? "OK" : "OVER", cardAuthResultToString(tap.result));
+  benchPrintf("[Budget] tap to unlock (worst): poll wait %lu us + %lu us = %lu us / budget %lu us: %s\n",
+              (unsigned long)tap.card.getPollWaitUs(), (unsigned long)detectUs, (unsigned long)totalUs,
+              (unsigned long)TAP_TOTAL_BUDGET_US, totalOk ? "OK" : "OVER");
+  return (detectOk ? 0 : 1) + (totalOk ? 0 : 1);
+}
+
+// 1件の判定を確認（expectedかalsoAcceptedなら正しい）
+static bool checkAuthCase(const char* name, SimCard& card, uint8_t keyNo, CardAuthResult expected,
+                          CardAuthResult alsoAccepted) {
+  CardAuthCredential cred;
+  cred.cardId = "";
+  cred.keyNo = keyNo;
+  memcpy(cred.key, SIM_CARD_KEY, CARD_AUTH_KEY_SIZE);
+  card.reset();
+  CardAuthResult result = cardAuthenticate(cred, SimCard::transceive, &card, simRandom);
+  bool ok = result == expected || result == alsoAccepted;
+  benchPrintf("  %-24s %-14s %s\n", name, cardAuthResultToString(result), ok ? "OK" : "WRONG");
+  return ok;
+}
+
+// 戻り値：判定を誤った件数
+static int checkAuthVerdicts() {
+  benchPrintf("\n[Auth] verdicts against the simulated card\n");
+  int wrong = 0;
+
+  SimCard genuine(SIM_CARD_KEY, 0);
+  if (!checkAuthCase("genuine", genuine, 0, CARD_AUTH_OK, CARD_AUTH_OK)) {
+    wrong++;
+  }
+  if (!checkAuthCase("wrong_key_no", genuine, 1, CARD_AUTH_KEY_REJECTED, CARD_AUTH_BAD_RESPONSE)) {
+    wrong++;
+  }
+
+  SimCard wrongKey(SIM_WRONG_KEY, 0);
+  if (!checkAuthCase("wrong_key", wrongKey, 0, CARD_AUTH_KEY_REJECTED, CARD_AUTH_BAD_RESPONSE)) {
+    wrong++;
+  }
+
+  SimCard noApp(SIM_CARD_KEY, 0);
+  noApp.setFault(SIM_FAULT_NO_APP);
+  if (!checkAuthCase("no_app", noApp, 0, CARD_AUTH_SELECT_FAILED, CARD_AUTH_SELECT_FAILED)) {
+    wrong++;
+  }
+
+  // アプリケーション選択・認証1段目・2段目のそれぞれで切れる
+  static const char* const dropNames[] = { "link_drop/select", "link_drop/auth1", "link_drop/auth2" };
+  for (int i = 0; i < 3; i++) {
+    SimCard dropped(SIM_CARD_KEY, 0);
+    dropped.setFault(SIM_FAULT_DROP_LINK, i);
+    if (!checkAuthCase(dropNames[i], dropped, 0, CARD_AUTH_LINK_ERROR, CARD_AUTH_LINK_ERROR)) {
+      wrong++;
+    }
+  }
+  return wrong;
+}
+
+static void runAll() {
+  buildCardTable();
+
+  benchRun("nfc/bytes_to_hex/felica", benchHexFelica, nullptr);
+  benchRun("nfc/bytes_to_hex/typea", benchHexTypeA, nullptr);
+
+  static DebounceCtx sameHit;
+  sameHit.debouncer.record(1, cardIds[0], 0);
+  sameHit.id = cardIds[0];
+  benchRun("nfc/is_same_card/hit", benchSameCard, &sameHit);
+  static DebounceCtx sameMiss;
+  sameMiss.debouncer.record(1, cardIds[0], 0);
+  sameMiss.id = cardIds[1];
+  benchRun("nfc/is_same_card/miss", benchSameCard, &sameMiss);
+
+  static const int sizes[] = { 10, 100, 1000 };
+  static const char* const hitNames[] = { "card/lookup_hit/10", "card/lookup_hit/100", "card/lookup_hit/1000" };
+  static const char* const missNames[] = { "card/lookup_miss/10", "card/lookup_miss/100", "card/lookup_miss/1000" };
+  static LookupCtx hits[3];
+  static LookupCtx misses[3];
+  for (int i = 0; i < 3; i++) {
+    // 登録済み（表の中央）と未登録（全件走査）
+    hits[i].count = sizes[i];
+    hits[i].id = cardIds[sizes[i] / 2];
+    benchRun(hitNames[i], benchFindCard, &hits[i]);
+    misses[i].count = sizes[i];
+    misses[i].id = "FFFFFFFFFFFFFFFF";
+    benchRun(missNames[i], benchFindCard, &misses[i]);
+  }
+
+  benchRun("cmd/parse/openlock", benchParseCommand, (void*)"openlock");
+  benchRun("cmd/parse/closelock_ws", benchParseCommand, (void*)"  closelock\r\n");
+  benchRun("cmd/parse/unknown", benchParseCommand, (void*)"status");
+  benchRun("udp/packet/openlock", benchUdpPacket, (void*)"openlock\n");
+
+  benchRun("msg/open_door/nfc", benchOpenDoorMessages, nullptr);
+  benchRun("msg/close_door/auto", benchCloseDoorMessages, nullptr);
+
+  benchRun("telemetry/encode_card_event", benchTelemetryCardEvent, nullptr);
+
+  static DoorCtx door;
+  door.now = 0;
+  door.i = 0;
+  benchRun("door/update", benchDoorUpdate, &door);
+
+  benchRun("auth/aes128/cbc_32", benchAesCbc32, nullptr);
+
+  for (int i = 0; i < 10; i++) {
+    tap.creds[i].cardId = cardIds[i];
+    tap.creds[i].keyNo = 0;
+    memcpy(tap.creds[i].key, SIM_CARD_KEY, CARD_AUTH_KEY_SIZE);
+  }
+  tap.id = cardIds[5];
+  tap.nsPerTap = benchRun("auth/tap_sim_card", benchTapWithAuth, &tap);
+}
+
+#ifdef ARDUINO
+
+void setup() {
+  Serial.begin(115200);
+  delay(2000);
+  benchPrintf("[Bench] CPU %lu MHz\n", (unsigned long)getCpuFrequencyMhz());
+
+  runAll();
+  int regressions = benchReport(BENCH_BASELINE_DEVICE);
+  int overBudget = checkTapBudget();
+  int wrongVerdicts = checkAuthVerdicts();
+
+  static char baseline[2048];
+  benchFormatBaseline(baseline, sizeof(baseline));
+  if (BENCH_BASELINE_DEVICE[0] != '\0') {
+    benchPrintf("\n[Bench] %d regression(s), %d over budget, %d wrong auth verdict(s). Baseline:\n",
+                regressions, overBudget, wrongVerdicts);
+  } else {
+    benchPrintf("\n[Bench] not compared (baseline_device.h is empty), %d over budget, %d wrong auth verdict(s). Baseline:\n",
+                overBudget, wrongVerdicts);
+  }
+  Serial.print(baseline);
+}
+
+void loop() {
+  delay(1000);
+}
+
+#else
+
+static char* readFile(const char* path) {
+  FILE* f = fopen(path, "rb");
+  if (f == nullptr) {
+    return nullptr;
+  }
+  static char text[4096];
+  size_t n = fread(text, 1, sizeof(text) - 1, f);
+  text[n] = '\0';
+  fclose(f);
+  return text;
+}
+
+int main(int argc, char** argv) {
+  const char* baselinePath = nullptr;
+  const char* savePath = nullptr;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--baseline") == 0 && i + 1 < argc) {
+      baselinePath = argv[++i];
+    } else if (strcmp(argv[i], "--save") == 0 && i + 1 < argc) {
+      savePath = argv[++i];
+    } else if (strcmp(argv[i], "--threshold") == 0 && i + 1 < argc) {
+      benchSetThreshold(atof(argv[++i]));
+    } else if (strcmp(argv[i], "--noise-ns") == 0 && i + 1 < argc) {
+      benchSetNoiseFloor(atof(argv[++i]));
+    } else {
+      fprintf(stderr, "usage: %s [--baseline FILE] [--save FILE] [--threshold PERCENT] [--noise-ns NS]\n", argv[0]);
+      return 2;
+    }
+  }
+
+  const char* baseline = nullptr;
+  if (baselinePath != nullptr) {
+    baseline = readFile(baselinePath);
+    if (baseline == nullptr) {
+      fprintf(stderr, "cannot read baseline: %s\n", baselinePath);
+      return 2;
+    }
+  }
+
+  runAll();
+  int regressions = benchReport(baseline);
+  int overBudget = checkTapBudget();
+  int wrongVerdicts = checkAuthVerdicts();
+
+  if (savePath != nullptr) {
+    static char text[4096];
+    size_t n = benchFormatBaseline(text, sizeof(text));
+    FILE* f = fopen(savePath, "wb");
+    if (f == nullptr) {
+      fprintf(stderr, "cannot write baseline: %s\n", savePath);
+      return 2;
+    }
+    fwrite(text, 1, n, f);
+    fclose(f);
+  }
+
+  // 予算超過・認証の判定誤り、またはベースラインと比較した場合は悪化があれば失敗にする
+  if (overBudget > 0 || wrongVerdicts > 0) {
+    return 1;
+  }
+  return (baseline != nullptr && regressions > 0) ? 1 : 0;
+}
+
+#endif
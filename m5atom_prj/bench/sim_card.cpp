@@ -0,0 +1,153 @@
+#include "sim_card.h"
+
+#include <string.h>
+
+#include "aes128.h"
+
+const SimLinkModel SIM_LINK_DEFAULT = {
+  50000,   // i2cClockHz
+  85,      // rfUsPerByte: 9ビット × 9.44us
+  1000,    // pn532Us
+  1000,    // cardSelectUs
+  5000,    // cardAuthUs
+  10000,   // felicaMissUs
+  150000   // pollIntervalUs
+};
+
+// PN532のフレーム長（I2C、アドレスバイトを含む）
+#define I2C_WRITE_OVERHEAD 11  // アドレス + 00 00 FF LEN LCS + D4 40 Tg + DCS 00
+#define I2C_ACK_BYTES      8   // アドレス + ステータス + 00 00 FF 00 FF 00
+#define I2C_READ_OVERHEAD  12  // アドレス + ステータス + 00 00 FF LEN LCS + D5 41 Status + DCS 00
+#define RF_FRAME_OVERHEAD  6   // I-block: PCB + CRC(2) を往復
+
+// カード検知（InListPassiveTarget、UID 7バイトのカード）
+#define SIM_UID_LEN        7
+#define SIM_ATS_LEN        6   // NTAG 424 DNA: 06 77 77 71 02 80
+#define I2C_LIST_CMD_BYTES 12  // アドレス + 00 00 FF LEN LCS + D4 4A MaxTg BrTy + DCS 00
+#define I2C_LIST_RESP_FIXED 17 // アドレス + ステータス + 00 00 FF LEN LCS + D5 4B NbTg Tg SENS_RES(2) SEL_RES NFCIDLen + DCS 00
+// REQA(1)/ATQA(2)、衝突防止・SELECTを2段（93/95 20 → UID(5)、SELECT(9) → SAK(3)）、RATS(4)/ATS(+CRC 2)
+#define RF_ACTIVATION_BYTES (1 + 2 + 2 * (2 + 5 + 9 + 3) + 4 + SIM_ATS_LEN + 2)
+
+SimCard::SimCard(const uint8_t key[CARD_AUTH_KEY_SIZE], uint8_t keyNo, const SimLinkModel& link)
+    : keyNo(keyNo), link(link), fault(SIM_FAULT_NONE), dropAt(0), rngState(0x2545F491) {
+  memcpy(this->key, key, CARD_AUTH_KEY_SIZE);
+  reset();
+}
+
+void SimCard::reset() {
+  selected = false;
+  authPending = false;
+  exchanges = 0;
+  linkUs = 0;
+  activationUs = 0;
+}
+
+void SimCard::setFault(SimCardFault fault, int dropAt) {
+  this->fault = fault;
+  this->dropAt = dropAt;
+}
+
+void SimCard::activate() {
+  uint32_t i2cBytes = I2C_LIST_CMD_BYTES + I2C_ACK_BYTES + (I2C_LIST_RESP_FIXED + SIM_UID_LEN + SIM_ATS_LEN);
+  activationUs = link.felicaMissUs +
+                 (uint32_t)((uint64_t)i2cBytes * 9 * 1000000 / link.i2cClockHz) +
+                 RF_ACTIVATION_BYTES * link.rfUsPerByte + link.pn532Us;
+}
+
+bool SimCard::transceive(void* ctx, const uint8_t* cmd, uint8_t cmdLen, uint8_t* resp, uint8_t* respLen) {
+  SimCard* card = static_cast<SimCard*>(ctx);
+  if (card->fault == SIM_FAULT_DROP_LINK && card->exchanges >= card->dropAt) {
+    // PN532がタイムアウトを返す（InDataExchangeの失敗）
+    return false;
+  }
+  uint32_t cardUs = card->handle(cmd, cmdLen, resp, respLen);
+
+  const SimLinkModel& link = card->link;
+  uint32_t i2cBytes = (I2C_WRITE_OVERHEAD + cmdLen) + I2C_ACK_BYTES + (I2C_READ_OVERHEAD + *respLen);
+  uint32_t rfBytes = cmdLen + *respLen + RF_FRAME_OVERHEAD;
+  card->linkUs += (uint32_t)((uint64_t)i2cBytes * 9 * 1000000 / link.i2cClockHz) +
+                  rfBytes * link.rfUsPerByte + link.pn532Us + cardUs;
+  card->exchanges++;
+  return true;
+}
+
+static void setStatus(uint8_t* resp, uint8_t* respLen, uint8_t len, uint8_t sw1, uint8_t sw2) {
+  resp[len] = sw1;
+  resp[len + 1] = sw2;
+  *respLen = len + 2;
+}
+
+static void rotateLeft(const uint8_t in[16], uint8_t out[16]) {
+  memcpy(out, in + 1, 15);
+  out[15] = in[0];
+}
+
+uint32_t SimCard::handle(const uint8_t* cmd, uint8_t cmdLen, uint8_t* resp, uint8_t* respLen) {
+  // ISOSelectFile（DF名）
+  if (cmdLen >= 5 && cmd[0] == 0x00 && cmd[1] == 0xA4 && cmd[2] == 0x04) {
+    if (fault == SIM_FAULT_NO_APP) {
+      selected = false;
+      setStatus(resp, respLen, 0, 0x6A, 0x82);
+      return link.cardSelectUs;
+    }
+    selected = true;
+    authPending = false;
+    setStatus(resp, respLen, 0, 0x90, 0x00);
+    return link.cardSelectUs;
+  }
+
+  if (cmdLen < 5 || cmd[0] != 0x90) {
+    setStatus(resp, respLen, 0, 0x6D, 0x00);
+    return 0;
+  }
+
+  Aes128 aes;
+  aes.setKey(key);
+  uint8_t iv[16] = { 0 };
+
+  // AuthenticateEV2First 1/2: E(K, RndB)
+  if (cmd[1] == 0x71 && cmdLen >= 6) {
+    if (!selected) {
+      setStatus(resp, respLen, 0, 0x91, 0x9D);
+      return 0;
+    }
+    if (cmd[5] != keyNo) {
+      setStatus(resp, respLen, 0, 0x91, 0x40);
+      return 0;
+    }
+    for (int i = 0; i < 16; i++) {
+      rngState ^= rngState << 13;
+      rngState ^= rngState >> 17;
+      rngState ^= rngState << 5;
+      rndB[i] = (uint8_t)rngState;
+    }
+    aes.encryptCbc(iv, rndB, resp, 16);
+    setStatus(resp, respLen, 16, 0x91, 0xAF);
+    authPending = true;
+    return link.cardAuthUs;
+  }
+
+  // AuthenticateEV2First 2/2: E(K, RndA || RndB') → E(K, TI || RndA' || PDcap2 || PCDcap2)
+  if (cmd[1] == 0xAF && authPending && cmdLen >= 5 + 32) {
+    authPending = false;
+    uint8_t plain[32];
+    aes.decryptCbc(iv, cmd + 5, plain, 32);
+    uint8_t expected[16];
+    rotateLeft(rndB, expected);
+    if (memcmp(plain + 16, expected, 16) != 0) {
+      setStatus(resp, respLen, 0, 0x91, 0xAE);
+      return link.cardAuthUs;
+    }
+
+    uint8_t answer[32] = { 0 };
+    memcpy(answer, "\x12\x34\x56\x78", 4);
+    rotateLeft(plain, answer + 4);
+    memset(iv, 0, sizeof(iv));
+    aes.encryptCbc(iv, answer, resp, 32);
+    setStatus(resp, respLen, 32, 0x91, 0x00);
+    return link.cardAuthUs;
+  }
+
+  setStatus(resp, respLen, 0, 0x91, 0x1C);
+  return 0;
+}
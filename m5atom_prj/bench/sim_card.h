@@ -0,0 +1,79 @@
+#ifndef SIM_CARD_H
+#define SIM_CARD_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "card_auth.h"
+
+// NTAG 424 DNA / DESFire EV2 の模擬カード（ISOSelectFile・AuthenticateEV2Firstのカード側）
+// 実機と同じcardAuthenticate()をそのまま通し、PN532経由の通信時間をフレーム長から見積もる
+
+// 通信時間のモデル（I2CはNFCReaderと同じ50kHz、それ以外はデータシート値からの概算）
+// 実機の "Card accepted: ... auth=XXus" ログと比べて合わなければここを直す
+struct SimLinkModel {
+  uint32_t i2cClockHz;      // I2Cクロック（1バイト = 9クロック）
+  uint32_t rfUsPerByte;     // 106kbps ISO14443-4（1バイト = 8ビット + パリティ）
+  uint32_t pn532Us;         // PN532のコマンド処理（1コマンドあたり）
+  uint32_t cardSelectUs;    // カード側の処理：ISOSelectFile
+  uint32_t cardAuthUs;      // カード側の処理：AuthenticateEV2Firstの各段（AES・乱数生成）
+  uint32_t felicaMissUs;    // sequential方式でTypeAの前に行うFeliCaポーリングの空振り（タイムアウト10ms）
+  uint32_t pollIntervalUs;  // カード検知の周期（main.cppのNFC_CHECK_INTERVAL）。かざしてから最大これだけ待つ
+};
+
+extern const SimLinkModel SIM_LINK_DEFAULT;
+
+// 異常系の再現（認証の判定が正しいかの確認用）
+enum SimCardFault {
+  SIM_FAULT_NONE,
+  SIM_FAULT_NO_APP,     // NDEFアプリケーションがない（ISOSelectFileに6A82を返す）
+  SIM_FAULT_DROP_LINK   // 指定した往復で通信が切れる（カードが離れた・ISO-DEPに応答しない）
+};
+
+class SimCard {
+public:
+  SimCard(const uint8_t key[CARD_AUTH_KEY_SIZE], uint8_t keyNo, const SimLinkModel& link = SIM_LINK_DEFAULT);
+
+  // タップごとに呼ぶ（選択状態・通信時間の見積もりをクリア）
+  void reset();
+  
+  // 異常系を設定（dropAtはSIM_FAULT_DROP_LINKで切れる往復の番号、0始まり）
+  void setFault(SimCardFault fault, int dropAt = 0);
+
+  // カード検知を模擬（FeliCaの空振り → InListPassiveTarget: REQA・衝突防止・SELECT・RATS）
+  void activate();
+
+  // CardTransceiveFunc形式（ctxはSimCard）
+  static bool transceive(void* ctx, const uint8_t* cmd, uint8_t cmdLen, uint8_t* resp, uint8_t* respLen);
+
+  // 直近のタップの往復回数・通信時間の見積もり（検知分は含まない）
+  int getExchanges() const { return exchanges; }
+  uint32_t getLinkUs() const { return linkUs; }
+  
+  // 直近のタップの検知にかかった時間の見積もり（activate()）
+  uint32_t getActivationUs() const { return activationUs; }
+  
+  // かざしてから検知のポーリングが始まるまでの最大の待ち
+  uint32_t getPollWaitUs() const { return link.pollIntervalUs; }
+
+private:
+  uint8_t key[CARD_AUTH_KEY_SIZE];
+  uint8_t keyNo;
+  SimLinkModel link;
+  SimCardFault fault;
+  int dropAt;
+
+  bool selected;
+  bool authPending;
+  uint8_t rndB[16];
+  uint32_t rngState;
+
+  int exchanges;
+  uint32_t linkUs;
+  uint32_t activationUs;
+
+  // APDUを処理して応答を作る（戻り値：カード側の処理時間[us]）
+  uint32_t handle(const uint8_t* cmd, uint8_t cmdLen, uint8_t* resp, uint8_t* respLen);
+};
+
+#endif // SIM_CARD_H
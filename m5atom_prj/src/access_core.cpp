@@ -0,0 +1,157 @@
+#include "access_core.h"
+
+#include <stdio.h>
+#include <string.h>
+
+static bool isSpace(char c) {
+  return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+static bool equalsToken(const char* s, size_t len, const char* token) {
+  size_t tokenLen = strlen(token);
+  return len == tokenLen && memcmp(s, token, len) == 0;
+}
+
+LockCommand parseCommand(const char* payload, size_t len) {
+  // 前後の空白を除去
+  while (len > 0 && isSpace(payload[0])) {
+    payload++;
+    len--;
+  }
+  while (len > 0 && isSpace(payload[len - 1])) {
+    len--;
+  }
+
+  if (equalsToken(payload, len, "openlock")) {
+    return CMD_OPENLOCK;
+  }
+  if (equalsToken(payload, len, "closelock")) {
+    return CMD_CLOSELOCK;
+  }
+  if (equalsToken(payload, len, "nfcmode sequential")) {
+    return CMD_NFC_SEQUENTIAL;
+  }
+  if (equalsToken(payload, len, "nfcmode autopoll")) {
+    return CMD_NFC_AUTOPOLL;
+  }
+  if (equalsToken(payload, len, "nfcstats")) {
+    return CMD_NFC_STATS;
+  }
+  return CMD_UNKNOWN;
+}
+
+LockCommand parseUdpPacket(char* buf, int len, size_t cap) {
+  if (cap == 0) {
+    return CMD_UNKNOWN;
+  }
+  if (len < 0) {
+    len = 0;
+  }
+  if ((size_t)len > cap - 1) {
+    len = (int)(cap - 1);
+  }
+  buf[len] = '\0';
+  return parseCommand(buf, (size_t)len);
+}
+
+void cardBytesToHex(const uint8_t* data, uint8_t len, char* out) {
+  static const char HEX_DIGITS[] = "0123456789ABCDEF";
+  for (uint8_t i = 0; i < len; i++) {
+    out[i * 2] = HEX_DIGITS[data[i] >> 4];
+    out[i * 2 + 1] = HEX_DIGITS[data[i] & 0x0F];
+  }
+  out[len * 2] = '\0';
+}
+
+void maskCardId(const char* cardID, char* out) {
+  const size_t visible = 4;
+  size_t len = strlen(cardID);
+  if (len > CARD_ID_BUF_SIZE - 1) {
+    len = CARD_ID_BUF_SIZE - 1;
+  }
+  for (size_t i = 0; i < len; i++) {
+    out[i] = (i + visible < len) ? '*' : cardID[i];
+  }
+  out[len] = '\0';
+}
+
+int findCardIndex(const char* const* ids, int count, const char* cardID) {
+  for (int i = 0; i < count; i++) {
+    if (strcmp(ids[i], cardID) == 0) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+CardDebouncer::CardDebouncer(unsigned long cooldownMs) : cooldownMs(cooldownMs), lastType(0),
+                                                         lastSeen(0), hasLast(false) {
+  lastId[0] = '\0';
+}
+
+bool CardDebouncer::isRepeat(uint8_t type, const char* id, unsigned long nowMs) const {
+  if (!hasLast || type != lastType) {
+    return false;
+  }
+  if (strcmp(id, lastId) != 0) {
+    return false;
+  }
+  if (nowMs - lastSeen > cooldownMs) {
+    return false;
+  }
+  return true;
+}
+
+void CardDebouncer::record(uint8_t type, const char* id, unsigned long nowMs) {
+  lastType = type;
+  strncpy(lastId, id, CARD_ID_BUF_SIZE - 1);
+  lastId[CARD_ID_BUF_SIZE - 1] = '\0';
+  lastSeen = nowMs;
+  hasLast = true;
+}
+
+int formatAccessLog(char* buf, size_t cap, bool unlock, AccessSource source, const char* cardName) {
+  const char* action = unlock ? "Door opened" : "Door closed";
+  switch (source) {
+    case ACCESS_NFC:
+      if (unlock) {
+        return snprintf(buf, cap, "%s via NFC: %s", action, cardName);
+      }
+      break;
+    case ACCESS_UDP:
+      return snprintf(buf, cap, "%s via UDP", action);
+    case ACCESS_AWS:
+      return snprintf(buf, cap, "%s via AWS IoT", action);
+    case ACCESS_AUTO:
+      if (!unlock) {
+        return snprintf(buf, cap, "%s (auto)", action);
+      }
+      break;
+    default:
+      break;
+  }
+  return snprintf(buf, cap, "%s", action);
+}
+
+int formatAccessNotification(char* buf, size_t cap, bool unlock, AccessSource source, const char* cardName) {
+  const char* action = unlock ? "ロックを解除しました" : "ロックをかけました";
+  switch (source) {
+    case ACCESS_NFC:
+      if (unlock) {
+        return snprintf(buf, cap, "%s\n経路: NFC (%s)", action, cardName);
+      }
+      break;
+    case ACCESS_UDP:
+      return snprintf(buf, cap, "%s\n経路: UDP", action);
+    case ACCESS_AWS:
+      return snprintf(buf, cap, "%s\n経路: AWS IoT", action);
+    case ACCESS_AUTO:
+      if (!unlock) {
+        return snprintf(buf, cap, "%s\n経路: 自動", action);
+      }
+      break;
+    default:
+      break;
+  }
+  return snprintf(buf, cap, "%s", action);
+}
@@ -0,0 +1,76 @@
+#ifndef ACCESS_CORE_H
+#define ACCESS_CORE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// タップ・コマンド受信ごとに実行される処理（Arduino非依存、ヒープ確保なし）
+// ベンチマーク（bench/）からもそのまま呼び出す
+
+// アクセス経路の種類
+enum AccessSource {
+  ACCESS_NFC,      // NFC経由
+  ACCESS_UDP,      // UDP経由
+  ACCESS_AWS,      // AWS IoT経由
+  ACCESS_AUTO,     // 自動（待機モード後の自動閉鎖）
+  ACCESS_SENSOR    // センサー検知
+};
+
+// コマンド（値はテレメトリのTEV_COMMANDでそのまま送るスキーマの一部なので、既存の値は変えず追加は末尾に）
+enum LockCommand {
+  CMD_UNKNOWN = 0,
+  CMD_OPENLOCK = 1,
+  CMD_CLOSELOCK = 2,
+  CMD_NFC_SEQUENTIAL = 3,  // "nfcmode sequential"
+  CMD_NFC_AUTOPOLL = 4,    // "nfcmode autopoll"
+  CMD_NFC_STATS = 5        // "nfcstats"
+};
+
+#define CARD_ID_MAX_BYTES 10
+#define CARD_ID_BUF_SIZE (CARD_ID_MAX_BYTES * 2 + 1)
+
+// コマンド文字列を解析（前後の空白・改行は無視）
+LockCommand parseCommand(const char* payload, size_t len);
+
+#define UDP_PACKET_BUF_SIZE 256
+
+// 受信したUDPパケットを終端してコマンドを解析（lenは受信長、capはbufの容量。bufは文字列として使える状態になる）
+LockCommand parseUdpPacket(char* buf, int len, size_t cap);
+
+// バイト列を大文字の16進数文字列に変換（out は len*2+1 バイト以上）
+void cardBytesToHex(const uint8_t* data, uint8_t len, char* out);
+
+// LAN等へ出すためにカードIDを伏せる（下4桁以外を*に置き換え、out は CARD_ID_BUF_SIZE バイト以上）
+// 登録カードのUIDはそれだけで解錠に使えるので、認証のない経路には全桁を出さない
+void maskCardId(const char* cardID, char* out);
+
+// 登録カード表からカードIDを検索（見つからなければ-1）
+int findCardIndex(const char* const* ids, int count, const char* cardID);
+
+// 同じカードの連続読み取りを防ぐ
+class CardDebouncer {
+public:
+  explicit CardDebouncer(unsigned long cooldownMs);
+
+  // 直前と同じカードがクールダウン中に再度読まれたか
+  bool isRepeat(uint8_t type, const char* id, unsigned long nowMs) const;
+
+  // 読み取ったカードを記録
+  void record(uint8_t type, const char* id, unsigned long nowMs);
+
+  // 記録を消す（次の読み取りは必ず新しいカード扱い）
+  void clear() { hasLast = false; }
+
+private:
+  unsigned long cooldownMs;
+  uint8_t lastType;
+  char lastId[CARD_ID_BUF_SIZE];
+  unsigned long lastSeen;
+  bool hasLast;
+};
+
+// 施錠・解錠時のログ/通知メッセージを構築（戻り値：snprintfと同じ）
+int formatAccessLog(char* buf, size_t cap, bool unlock, AccessSource source, const char* cardName);
+int formatAccessNotification(char* buf, size_t cap, bool unlock, AccessSource source, const char* cardName);
+
+#endif // ACCESS_CORE_H
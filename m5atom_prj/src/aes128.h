@@ -0,0 +1,40 @@
+#ifndef AES128_H
+#define AES128_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef ARDUINO
+#include "aes/esp_aes.h"
+#endif
+
+#define AES128_BLOCK_SIZE 16
+#define AES128_KEY_SIZE 16
+
+// AES-128（実機はESP32のハードウェアAES、ネイティブはソフトウェア実装）
+class Aes128 {
+public:
+  Aes128();
+  ~Aes128();
+
+  void setKey(const uint8_t key[AES128_KEY_SIZE]);
+
+  // CBCモード（lenは16の倍数、ivは最後の暗号文ブロックに更新される）
+  void encryptCbc(uint8_t iv[AES128_BLOCK_SIZE], const uint8_t* in, uint8_t* out, size_t len);
+  void decryptCbc(uint8_t iv[AES128_BLOCK_SIZE], const uint8_t* in, uint8_t* out, size_t len);
+
+private:
+#ifdef ARDUINO
+  esp_aes_context ctx;
+#else
+  uint8_t roundKeys[176];
+
+  void encryptBlock(const uint8_t in[AES128_BLOCK_SIZE], uint8_t out[AES128_BLOCK_SIZE]) const;
+  void decryptBlock(const uint8_t in[AES128_BLOCK_SIZE], uint8_t out[AES128_BLOCK_SIZE]) const;
+#endif
+
+  Aes128(const Aes128&);
+  Aes128& operator=(const Aes128&);
+};
+
+#endif // AES128_H
@@ -0,0 +1,168 @@
+#include "card_auth.h"
+
+#include <string.h>
+
+#include "aes128.h"
+
+#define RND_SIZE 16
+
+// ISOSelectFile（DF名でNDEFアプリケーションを選択、FCIは返さない）
+static const uint8_t SELECT_NDEF_APP[] = {
+  0x00, 0xA4, 0x04, 0x0C, 0x07, 0xD2, 0x76, 0x00, 0x00, 0x85, 0x01, 0x01, 0x00
+};
+
+// ISO 7816-4でラップしたネイティブコマンドのヘッダ
+#define CLA_NATIVE              0x90
+#define INS_AUTH_EV2_FIRST      0x71
+#define INS_ADDITIONAL_FRAME    0xAF
+
+static bool hasStatus(const uint8_t* resp, uint8_t len, uint8_t sw1, uint8_t sw2) {
+  return len >= 2 && resp[len - 2] == sw1 && resp[len - 1] == sw2;
+}
+
+// 1バイト左ローテート（RndA' / RndB'）
+static void rotateLeft(const uint8_t in[RND_SIZE], uint8_t out[RND_SIZE]) {
+  memcpy(out, in + 1, RND_SIZE - 1);
+  out[RND_SIZE - 1] = in[0];
+}
+
+const CardAuthCredential* findCardCredential(const CardAuthCredential* creds, int count, const char* cardId) {
+  for (int i = 0; i < count; i++) {
+    if (creds[i].cardId[0] != '\0' && strcmp(creds[i].cardId, cardId) == 0) {
+      return &creds[i];
+    }
+  }
+  return nullptr;
+}
+
+CardAuthResult cardAuthenticate(const CardAuthCredential& cred, CardTransceiveFunc transceive, void* ctx,
+                                CardRandomFunc random) {
+  uint8_t resp[CARD_AUTH_RESP_MAX];
+  uint8_t respLen = sizeof(resp);
+
+  // 応答待ちの間に計算できるものは先に用意しておく
+  uint8_t rndA[RND_SIZE];
+  random(rndA, RND_SIZE);
+  Aes128 aes;
+  aes.setKey(cred.key);
+
+  // 1) NDEFアプリケーションを選択
+  if (!transceive(ctx, SELECT_NDEF_APP, sizeof(SELECT_NDEF_APP), resp, &respLen)) {
+    return CARD_AUTH_LINK_ERROR;
+  }
+  if (!hasStatus(resp, respLen, 0x90, 0x00)) {
+    return CARD_AUTH_SELECT_FAILED;
+  }
+
+  // 2) AuthenticateEV2First（鍵番号、PCDcap2なし）→ E(K, RndB)
+  const uint8_t auth1[] = { CLA_NATIVE, INS_AUTH_EV2_FIRST, 0x00, 0x00, 0x02, cred.keyNo, 0x00, 0x00 };
+  respLen = sizeof(resp);
+  if (!transceive(ctx, auth1, sizeof(auth1), resp, &respLen)) {
+    return CARD_AUTH_LINK_ERROR;
+  }
+  if (!hasStatus(resp, respLen, 0x91, INS_ADDITIONAL_FRAME)) {
+    return respLen == 2 ? CARD_AUTH_KEY_REJECTED : CARD_AUTH_BAD_RESPONSE;
+  }
+  if (respLen != RND_SIZE + 2) {
+    return CARD_AUTH_BAD_RESPONSE;
+  }
+
+  uint8_t iv[AES128_BLOCK_SIZE] = { 0 };
+  uint8_t rndB[RND_SIZE];
+  aes.decryptCbc(iv, resp, rndB, RND_SIZE);
+
+  // 3) E(K, RndA || RndB') を送る → E(K, TI || RndA' || PDcap2 || PCDcap2)
+  uint8_t plain[RND_SIZE * 2];
+  memcpy(plain, rndA, RND_SIZE);
+  rotateLeft(rndB, plain + RND_SIZE);
+
+  uint8_t auth2[5 + RND_SIZE * 2 + 1] = { CLA_NATIVE, INS_ADDITIONAL_FRAME, 0x00, 0x00, RND_SIZE * 2 };
+  memset(iv, 0, sizeof(iv));
+  aes.encryptCbc(iv, plain, auth2 + 5, RND_SIZE * 2);
+  auth2[sizeof(auth2) - 1] = 0x00;
+
+  respLen = sizeof(resp);
+  if (!transceive(ctx, auth2, sizeof(auth2), resp, &respLen)) {
+    return CARD_AUTH_LINK_ERROR;
+  }
+  if (!hasStatus(resp, respLen, 0x91, 0x00)) {
+    return respLen == 2 ? CARD_AUTH_KEY_REJECTED : CARD_AUTH_BAD_RESPONSE;
+  }
+  if (respLen != RND_SIZE * 2 + 2) {
+    return CARD_AUTH_BAD_RESPONSE;
+  }
+
+  memset(iv, 0, sizeof(iv));
+  aes.decryptCbc(iv, resp, plain, RND_SIZE * 2);
+
+  // カードが同じ鍵を持っていればRndAを1バイト回転したものが返る
+  uint8_t expected[RND_SIZE];
+  rotateLeft(rndA, expected);
+  if (memcmp(plain + 4, expected, RND_SIZE) != 0) {
+    return CARD_AUTH_BAD_RESPONSE;
+  }
+  return CARD_AUTH_OK;
+}
+
+// CMACのサブ鍵（1ビット左シフト、最上位ビットが立っていれば0x87をXOR）
+static void cmacSubkey(const uint8_t in[AES128_BLOCK_SIZE], uint8_t out[AES128_BLOCK_SIZE]) {
+  uint8_t carry = 0;
+  for (int i = AES128_BLOCK_SIZE - 1; i >= 0; i--) {
+    out[i] = (uint8_t)((in[i] << 1) | carry);
+    carry = in[i] >> 7;
+  }
+  if (carry) {
+    out[AES128_BLOCK_SIZE - 1] ^= 0x87;
+  }
+}
+
+bool cardAuthDiversifyKey(const uint8_t masterKey[CARD_AUTH_KEY_SIZE], const uint8_t* input, size_t inputLen,
+                          uint8_t out[CARD_AUTH_KEY_SIZE]) {
+  // D = 0x01 || 入力 を32バイトにパディングしてCMACを計算
+  const size_t dataLen = AES128_BLOCK_SIZE * 2;
+  if (inputLen == 0 || inputLen > dataLen - 1) {
+    return false;
+  }
+
+  Aes128 aes;
+  aes.setKey(masterKey);
+
+  uint8_t zero[AES128_BLOCK_SIZE] = { 0 };
+  uint8_t iv[AES128_BLOCK_SIZE] = { 0 };
+  uint8_t l[AES128_BLOCK_SIZE];
+  aes.encryptCbc(iv, zero, l, AES128_BLOCK_SIZE);
+  uint8_t k1[AES128_BLOCK_SIZE];
+  uint8_t k2[AES128_BLOCK_SIZE];
+  cmacSubkey(l, k1);
+  cmacSubkey(k1, k2);
+
+  uint8_t data[dataLen];
+  memset(data, 0, sizeof(data));
+  data[0] = 0x01;
+  memcpy(data + 1, input, inputLen);
+  bool padded = inputLen + 1 < dataLen;
+  if (padded) {
+    data[inputLen + 1] = 0x80;
+  }
+  const uint8_t* subkey = padded ? k2 : k1;
+  for (int i = 0; i < AES128_BLOCK_SIZE; i++) {
+    data[AES128_BLOCK_SIZE + i] ^= subkey[i];
+  }
+
+  uint8_t cipher[dataLen];
+  memset(iv, 0, sizeof(iv));
+  aes.encryptCbc(iv, data, cipher, dataLen);
+  memcpy(out, cipher + AES128_BLOCK_SIZE, CARD_AUTH_KEY_SIZE);
+  return true;
+}
+
+const char* cardAuthResultToString(CardAuthResult result) {
+  switch (result) {
+    case CARD_AUTH_OK:            return "ok";
+    case CARD_AUTH_LINK_ERROR:    return "link_error";
+    case CARD_AUTH_SELECT_FAILED: return "select_failed";
+    case CARD_AUTH_KEY_REJECTED:  return "key_rejected";
+    case CARD_AUTH_BAD_RESPONSE:  return "bad_response";
+    default:                      return "unknown";
+  }
+}
@@ -0,0 +1,54 @@
+#ifndef CARD_AUTH_H
+#define CARD_AUTH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// AES対応カード（NTAG 424 DNA / DESFire EV2）の暗号認証（Arduino非依存）
+// UIDの照合に加えて、カードごとの鍵を持っていることをAuthenticateEV2Firstで確認する（UIDだけの複製カードを拒否）
+//
+// タップ時の往復はPN532のInDataExchange 3回のみ（各APDUは1フレームに収まり、チェイニングなし）
+//   1) ISOSelectFile: NDEFアプリケーション（DF名 D2760000850101）
+//   2) AuthenticateEV2First 1/2: E(K, RndB) を受け取る
+//   3) AuthenticateEV2First 2/2: E(K, RndA || RndB') を送り、E(K, TI || RndA' || ...) を検証
+// 鍵の多様化はプロビジョニング時に済ませ（tools/card_provision）、本体はカードごとの鍵だけを持つ
+
+#define CARD_AUTH_KEY_SIZE 16
+#define CARD_AUTH_RESP_MAX 64
+
+enum CardAuthResult {
+  CARD_AUTH_OK,
+  CARD_AUTH_LINK_ERROR,      // カードとの通信に失敗（タップが短すぎた等）
+  CARD_AUTH_SELECT_FAILED,   // アプリケーションが無い（AES非対応カード）
+  CARD_AUTH_KEY_REJECTED,    // カードが鍵番号・認証を拒否
+  CARD_AUTH_BAD_RESPONSE     // 応答が不正（RndA'が一致しない等）
+};
+
+// 認証が必要なカード
+struct CardAuthCredential {
+  const char* cardId;                 // UID（ALLOWED_CARD_IDSと同じ16進数文字列）
+  uint8_t keyNo;                      // アプリケーション内の鍵番号
+  uint8_t key[CARD_AUTH_KEY_SIZE];    // このカード用に多様化済みの鍵
+};
+
+// カードとAPDUを送受信する（respLen: 入力はバッファ長、出力は受信長。失敗ならfalse）
+typedef bool (*CardTransceiveFunc)(void* ctx, const uint8_t* cmd, uint8_t cmdLen, uint8_t* resp, uint8_t* respLen);
+
+// 乱数を生成する
+typedef void (*CardRandomFunc)(uint8_t* out, size_t len);
+
+// カードIDから認証情報を検索（見つからなければnullptr = UID照合のみ）
+const CardAuthCredential* findCardCredential(const CardAuthCredential* creds, int count, const char* cardId);
+
+// 検知済みのカードと相互認証する
+CardAuthResult cardAuthenticate(const CardAuthCredential& cred, CardTransceiveFunc transceive, void* ctx,
+                                CardRandomFunc random);
+
+// AN10922のAES-128鍵多様化（プロビジョニング用）
+// input: 多様化入力（UID || AID || システム識別子 など、1〜31バイト）
+bool cardAuthDiversifyKey(const uint8_t masterKey[CARD_AUTH_KEY_SIZE], const uint8_t* input, size_t inputLen,
+                          uint8_t out[CARD_AUTH_KEY_SIZE]);
+
+const char* cardAuthResultToString(CardAuthResult result);
+
+#endif // CARD_AUTH_H
@@ -0,0 +1,152 @@
+#include "door_detector.h"
+
+#define RANGE_STATUS_VALID 0
+#define RANGE_STATUS_MIN_RANGE_FAIL 3  // 近すぎて測れない（ドアが閉じた位置が近い場合に出続ける）
+#define RANGE_STATUS_PHASE_FAIL 4      // 範囲外（ドアが開いていて対象物がない）
+
+DoorDetector::DoorDetector() {
+  setConfig(defaultConfig());
+}
+
+DoorDetector::DoorDetector(const DoorDetectorConfig& config) {
+  setConfig(config);
+}
+
+DoorDetectorConfig DoorDetector::defaultConfig() {
+  DoorDetectorConfig c;
+  c.closeThresholdMm = 40;
+  c.openThresholdMm = 60;
+  c.clampMm = 120;
+  c.medianWindow = 5;
+  c.emaAlpha = 0.6f;
+  c.minSignalRateMcps = 0.25f;
+  c.closeConfirmSamples = 3;
+  c.openConfirmSamples = 2;
+  c.closeConfirmMs = 100;
+  c.openConfirmMs = 50;
+  c.maxInvalidRun = 10;
+  return c;
+}
+
+void DoorDetector::setConfig(const DoorDetectorConfig& newConfig) {
+  config = newConfig;
+  if (config.medianWindow < 1) {
+    config.medianWindow = 1;
+  }
+  if (config.medianWindow > DOOR_MEDIAN_MAX) {
+    config.medianWindow = DOOR_MEDIAN_MAX;
+  }
+  if (config.openThresholdMm < config.closeThresholdMm) {
+    config.openThresholdMm = config.closeThresholdMm;
+  }
+  if (config.clampMm < config.openThresholdMm) {
+    config.clampMm = config.openThresholdMm;
+  }
+  reset(DOOR_OPEN);
+  rejectedCount = 0;
+  transitionCount = 0;
+}
+
+void DoorDetector::reset(DoorState initial) {
+  state = initial;
+  windowCount = 0;
+  windowPos = 0;
+  filteredMm = 0;
+  filterPrimed = false;
+  evidence = 0;
+  candidateStart = 0;
+  invalidRun = 0;
+}
+
+bool DoorDetector::update(unsigned long nowMs, uint16_t rangeMm, uint8_t rangeStatus, float signalRateMcps) {
+  // 1) 測定値の選別
+  uint16_t sample;
+  if (rangeStatus == RANGE_STATUS_PHASE_FAIL) {
+    // 範囲外は「遠い」という有効な情報
+    sample = config.clampMm;
+  } else if (rangeStatus == RANGE_STATUS_MIN_RANGE_FAIL && signalRateMcps >= config.minSignalRateMcps) {
+    // 最小距離エラーは「近い」という有効な情報（距離の値は当てにならないのでCLOSE側に寄せる）
+    sample = (rangeMm < config.closeThresholdMm || config.closeThresholdMm == 0) ? rangeMm : config.closeThresholdMm - 1;
+  } else if (rangeStatus == RANGE_STATUS_VALID && signalRateMcps >= config.minSignalRateMcps) {
+    sample = rangeMm < config.clampMm ? rangeMm : config.clampMm;
+  } else {
+    // sigma/信号不足・外光で信号が弱い測定は捨てる
+    rejectedCount++;
+    if (invalidRun < 0xFF) {
+      invalidRun++;
+    }
+    if (invalidRun >= config.maxInvalidRun) {
+      evidence = 0;
+    }
+    return false;
+  }
+  invalidRun = 0;
+
+  // 2) メディアン → EMA
+  window[windowPos] = sample;
+  windowPos = (windowPos + 1) % config.medianWindow;
+  if (windowCount < config.medianWindow) {
+    windowCount++;
+  }
+  float m = median();
+  if (!filterPrimed) {
+    filteredMm = m;
+    filterPrimed = true;
+  } else {
+    filteredMm += config.emaAlpha * (m - filteredMm);
+  }
+
+  // 3) ヒステリシス付きの判定と根拠の蓄積
+  bool supportsOther;
+  if (state == DOOR_OPEN) {
+    supportsOther = filteredMm < config.closeThresholdMm;
+  } else {
+    supportsOther = filteredMm > config.openThresholdMm;
+  }
+
+  if (supportsOther) {
+    if (evidence == 0) {
+      candidateStart = nowMs;
+    }
+    if (evidence < 0xFF) {
+      evidence++;
+    }
+  } else if (evidence > 0) {
+    // 1サンプルの揺れで振り出しに戻らないよう、根拠を減らすだけにする
+    evidence = evidence >= 2 ? evidence - 2 : 0;
+  }
+
+  uint8_t needSamples = state == DOOR_OPEN ? config.closeConfirmSamples : config.openConfirmSamples;
+  unsigned long needMs = state == DOOR_OPEN ? config.closeConfirmMs : config.openConfirmMs;
+  if (evidence >= needSamples && nowMs - candidateStart >= needMs) {
+    state = (state == DOOR_OPEN) ? DOOR_CLOSE : DOOR_OPEN;
+    evidence = 0;
+    transitionCount++;
+    return true;
+  }
+  return false;
+}
+
+float DoorDetector::getConfidence() const {
+  uint8_t needSamples = state == DOOR_OPEN ? config.closeConfirmSamples : config.openConfirmSamples;
+  if (needSamples == 0) {
+    return 1.0f;
+  }
+  float c = (float)evidence / needSamples;
+  return c > 1.0f ? 1.0f : c;
+}
+
+uint16_t DoorDetector::median() const {
+  uint16_t sorted[DOOR_MEDIAN_MAX];
+  for (uint8_t i = 0; i < windowCount; i++) {
+    // 挿入ソート（要素数が少ないので十分速い）
+    uint16_t v = window[i];
+    uint8_t j = i;
+    while (j > 0 && sorted[j - 1] > v) {
+      sorted[j] = sorted[j - 1];
+      j--;
+    }
+    sorted[j] = v;
+  }
+  return sorted[windowCount / 2];
+}
@@ -0,0 +1,74 @@
+#ifndef DOOR_DETECTOR_H
+#define DOOR_DETECTOR_H
+
+#include <stdint.h>
+
+// ドア状態
+enum DoorState { DOOR_OPEN, DOOR_CLOSE };
+
+// 検知パラメータ
+struct DoorDetectorConfig {
+  uint16_t closeThresholdMm;   // フィルタ後の距離がこれ未満でCLOSE候補
+  uint16_t openThresholdMm;    // フィルタ後の距離がこれを超えたらOPEN候補（ヒステリシス）
+  uint16_t clampMm;            // これより遠い値は同じ扱い（EMAの遅れを防ぐ）
+  uint8_t medianWindow;        // メディアンフィルタの窓（奇数、最大 DOOR_MEDIAN_MAX）
+  float emaAlpha;              // EMAの係数（0〜1、大きいほど追従が速い）
+  float minSignalRateMcps;     // これ未満の信号強度の測定値は捨てる（強い外光対策）
+  uint8_t closeConfirmSamples; // CLOSE確定に必要な根拠サンプル数
+  uint8_t openConfirmSamples;  // OPEN確定に必要な根拠サンプル数
+  unsigned long closeConfirmMs; // CLOSE確定に必要な最短継続時間
+  unsigned long openConfirmMs;  // OPEN確定に必要な最短継続時間
+  uint8_t maxInvalidRun;       // 無効な測定がこれだけ続いたら蓄積した根拠を捨てる
+};
+
+#define DOOR_MEDIAN_MAX 7
+
+// VL53L0Xの測定値列からドア開閉を判定する
+// Arduino非依存なので、記録した測定値列をホスト上で再生して検証・調整できる
+class DoorDetector {
+public:
+  DoorDetector();
+  explicit DoorDetector(const DoorDetectorConfig& config);
+
+  static DoorDetectorConfig defaultConfig();
+
+  void setConfig(const DoorDetectorConfig& config);
+  const DoorDetectorConfig& getConfig() const { return config; }
+
+  // 測定値を1つ入力（戻り値：状態が変化したらtrue）
+  // rangeStatus: VL53L0XのRangeStatus（0=有効、3=近すぎ、4=範囲外。それ以外は捨てる）
+  bool update(unsigned long nowMs, uint16_t rangeMm, uint8_t rangeStatus, float signalRateMcps);
+
+  void reset(DoorState initial = DOOR_OPEN);
+
+  DoorState getState() const { return state; }
+  float getFilteredMm() const { return filteredMm; }
+
+  // 状態遷移の確からしさ（0〜1、候補状態への根拠の蓄積度合い）
+  float getConfidence() const;
+
+  // 統計
+  unsigned long getRejectedCount() const { return rejectedCount; }
+  unsigned long getTransitionCount() const { return transitionCount; }
+
+private:
+  DoorDetectorConfig config;
+  DoorState state;
+
+  uint16_t window[DOOR_MEDIAN_MAX];
+  uint8_t windowCount;
+  uint8_t windowPos;
+  float filteredMm;
+  bool filterPrimed;
+
+  uint8_t evidence;              // 候補状態を支持するサンプル数
+  unsigned long candidateStart;  // 候補状態の開始時刻
+  uint8_t invalidRun;
+
+  unsigned long rejectedCount;
+  unsigned long transitionCount;
+
+  uint16_t median() const;
+};
+
+#endif // DOOR_DETECTOR_H
@@ -8,8 +8,22 @@
 #include <WiFiUdp.h>
 #include <MQTTClient.h>
 #include <HTTPClient.h>
+#include <sys/time.h>
 #include "secrets.h"
+#include "access_core.h"
 #include "nfc.h"
+#include "status_server.h"
+#include "notifier.h"
+#include "supervisor.h"
+#include "door_detector.h"
+#include "telemetry.h"
+#include "card_auth.h"
+
+// カード認証の追加前のsecrets.hには認証情報がないので、全カードUIDのみで照合する
+#ifndef CARD_AUTH_CREDENTIAL_COUNT
+const CardAuthCredential* const CARD_AUTH_CREDENTIALS = nullptr;
+#define CARD_AUTH_CREDENTIAL_COUNT 0
+#endif
 
 // システムモード定義
 enum SystemMode {
@@ -17,15 +31,6 @@ enum SystemMode {
   WAITING_MODE     // ドア開閉待機モード
 };
 
-// アクセス経路の種類
-enum AccessSource {
-  ACCESS_NFC,      // NFC経由
-  ACCESS_UDP,      // UDP経由
-  ACCESS_AWS,      // AWS IoT経由
-  ACCESS_AUTO,     // 自動（待機モード後の自動閉鎖）
-  ACCESS_SENSOR    // センサー検知
-};
-
 // センサー
 Adafruit_VL53L0X lox = Adafruit_VL53L0X();
 
@@ -42,6 +47,7 @@ const int MOVE_DELAY = 600;
 const uint16_t AWS_PORT = 8883;
 const char* topicSub = "smartlock/cmd";
 const char* topicPub = "smartlock/log";
+const char* topicTelemetry = "smartlock/telemetry";
 
 // WiFi/MQTT/UDP
 WiFiClientSecure wifi_s;
@@ -50,50 +56,249 @@ WiFiUDP udpControl;
 const uint16_t UDP_PORT = 4210;
 HTTPClient http;
 
+// LAN向け状態・イベント配信
+const uint16_t STATUS_PORT = 4211;
+StatusServer statusServer(STATUS_PORT);
+
 // タイミング定数
 const unsigned long WAITING_TIMEOUT = 15000; // 15秒
 const unsigned long WIFI_CHECK_INTERVAL = 30000; // 30秒
 const unsigned long MQTT_CHECK_INTERVAL = 30000; // 30秒
-const unsigned long NFC_CONNECTION_CHECK_INTERVAL = 10000; // 10秒
 const unsigned long NFC_CHECK_INTERVAL = 150; // 150ms
+const NFCDetectMode NFC_DEFAULT_DETECT_MODE = NFC_DETECT_SEQUENTIAL; // "nfcmode autopoll"コマンドで切り替え可能
 const unsigned long DISPLAY_UPDATE_INTERVAL = 100; // 100ms
-const unsigned long DOOR_DEBOUNCE_TIME = 2000; // 2秒
 const unsigned long WIFI_RECONNECT_TIMEOUT = 10000; // 10秒
 const unsigned long MAX_ERROR_COUNT = 5; // 連続エラー上限
+const unsigned long NFC_BUS_CLEAR_SETTLE = 1000; // I2Cバス解除後の確認待ち 1秒
+const unsigned long NFC_RESET_SETTLE = 3000; // PN532再初期化後の確認待ち 3秒
+const unsigned long NFC_RECOVERY_HOLD = 5000; // 正常なポーリングが5秒続いたら復旧とみなす
+const unsigned long WIFI_RECOVERY_HOLD = 20000; // 次の接続確認（30秒後）でも接続中なら復旧とみなす
+const unsigned long TELEMETRY_FLUSH_INTERVAL = 1000; // 1秒
+const int TELEMETRY_PENDING_BATCHES = 2; // 次の送信までに溜められる一杯のバッチ数
+const int CARD_AUTH_LINK_ERROR_LIMIT = 3; // 同じカードで認証の通信エラーがこの回数続いたら拒否する
+const unsigned long CARD_AUTH_LINK_LOG_INTERVAL = 10000; // 認証中断ログの最短間隔 10秒
+const size_t ACCESS_MESSAGE_SIZE = 160; // ログ・通知メッセージの最大長
+const time_t TIME_SYNCED_EPOCH = 1700000000; // これより前の時刻はSNTP未同期とみなす
 
 // システム状態管理
 SystemMode currentMode = NORMAL;
 unsigned long modeStartTime = 0;
 
 // ドア状態検知
-enum DoorState { DOOR_OPEN, DOOR_CLOSE };
+DoorDetector doorDetector;
 DoorState doorState = DOOR_OPEN;
 DoorState lastDoorState = DOOR_OPEN;
-unsigned long doorCloseStartTime = 0;
+const bool DOOR_SAMPLE_LOG = false; // trueで測定値をCSVでSerialに出力（tools/door_replay で再生して検証する）
 bool hasSeenOpenInWaitingMode = false;
 
+// ロック状態（最後に実行したサーボ操作）
+enum LockState { LOCK_UNKNOWN, LOCK_LOCKED, LOCK_UNLOCKED };
+LockState lockState = LOCK_UNKNOWN;
+
 // NFC状態
 String lastNfcCardID = "";
+String lastNfcCardMasked = "";  // LANへ出す伏せ字のID
 CardType lastNfcCardType = CARD_NONE;
 unsigned long lastNfcCheckTime = 0;
 
-// エラーカウント
-unsigned int wifiErrorCount = 0;
-unsigned int nfcErrorCount = 0;
+// カード認証の通信エラー（同じカードで連続した回数、ログの間引き）
+String linkErrorCardID = "";
+int linkErrorCount = 0;
+unsigned long lastLinkErrorLog = 0;
+int suppressedLinkErrorLogs = 0;
+
+// 障害の段階的復旧
+FaultSupervisor supervisor;
+
+// 構造化テレメトリ（CBORでまとめてpublish）
+TelemetryBatch telemetryBatch;
+TelemetryBatch telemetryFull[TELEMETRY_PENDING_BATCHES];  // 一杯になり送信待ちのバッチ（loopで送る）
+int telemetryFullCount = 0;
+uint32_t telemetryDropped = 0;
+uint32_t telemetrySeq = 0;
+uint32_t bootId = 0;
+portMUX_TYPE telemetryMux = portMUX_INITIALIZER_UNLOCKED;
 
 // マルチタスク管理
 TaskHandle_t wifiTaskHandle = NULL;
+TaskHandle_t statusTaskHandle = NULL;
 volatile bool isWifiReconnecting = false;
 
 // ログをAWS IoT Coreに送信
-void publishLog(const String& msg) {
+void publishLog(const char* msg) {
   if (!client.connected()) return;
-  Serial.println("[LOG] " + msg);
-  client.publish(topicPub, msg.c_str());
+  Serial.print("[LOG] ");
+  Serial.println(msg);
+  client.publish(topicPub, msg);
+}
+
+void publishLog(const String& msg) {
+  publishLog(msg.c_str());
+}
+
+// テレメトリイベントを作成（シーケンス番号・時刻を付与）
+TelemetryEvent makeTelemetryEvent(TelemetryEventType type) {
+  TelemetryEvent ev;
+  telemetryInitEvent(&ev, type);
+  portENTER_CRITICAL(&telemetryMux);
+  ev.seq = telemetrySeq++;
+  portEXIT_CRITICAL(&telemetryMux);
+  ev.bootId = bootId;
+  ev.uptimeMs = millis();
+  
+  struct timeval tv;
+  gettimeofday(&tv, nullptr);
+  if (tv.tv_sec > TIME_SYNCED_EPOCH) {
+    ev.unixMs = (uint64_t)tv.tv_sec * 1000 + tv.tv_usec / 1000;
+    ev.fields |= TF_UNIX_MS;
+  }
+  return ev;
+}
+
+void publishTelemetry(const TelemetryBatch& batch) {
+  if (!client.connected()) {
+    Serial.printf("[Telemetry] Not connected, dropped %u events\n", batch.eventCount());
+    return;
+  }
+  client.publish(topicTelemetry, (const char*)batch.data(), (int)batch.size());
+}
+
+// テレメトリイベントを記録（どのタスクから呼んでもよい。送信はloopのflushTelemetryだけが行う）
+// MQTTClientはスレッドセーフではないので、WiFi管理タスクからはバッファに積むだけにする
+void recordTelemetry(const TelemetryEvent& ev) {
+  portENTER_CRITICAL(&telemetryMux);
+  if (!telemetryBatch.append(ev)) {
+    // 一杯のバッチは送信待ちへ（送信待ちも一杯なら最も古いものを捨てる）
+    if (telemetryFullCount == TELEMETRY_PENDING_BATCHES) {
+      telemetryDropped += telemetryFull[0].eventCount();
+      for (int i = 1; i < TELEMETRY_PENDING_BATCHES; i++) {
+        telemetryFull[i - 1] = telemetryFull[i];
+      }
+      telemetryFullCount--;
+    }
+    telemetryFull[telemetryFullCount++] = telemetryBatch;
+    telemetryBatch.clear();
+    telemetryBatch.append(ev);
+  }
+  portEXIT_CRITICAL(&telemetryMux);
+}
+
+// 溜まっているテレメトリを送信（loopから呼ぶ）
+void flushTelemetry() {
+  if (!client.connected()) {
+    return;
+  }
+  TelemetryBatch pending[TELEMETRY_PENDING_BATCHES + 1];
+  int count = 0;
+  uint32_t dropped;
+  portENTER_CRITICAL(&telemetryMux);
+  for (int i = 0; i < telemetryFullCount; i++) {
+    pending[count++] = telemetryFull[i];
+  }
+  telemetryFullCount = 0;
+  if (!telemetryBatch.empty()) {
+    pending[count++] = telemetryBatch;
+    telemetryBatch.clear();
+  }
+  dropped = telemetryDropped;
+  telemetryDropped = 0;
+  portEXIT_CRITICAL(&telemetryMux);
+  
+  if (dropped > 0) {
+    Serial.printf("[Telemetry] Buffer full, dropped %lu events\n", (unsigned long)dropped);
+  }
+  for (int i = 0; i < count; i++) {
+    publishTelemetry(pending[i]);
+  }
+}
+
+const char* modeToString(SystemMode mode) {
+  return mode == WAITING_MODE ? "WAITING" : "NORMAL";
+}
+
+const char* doorStateToString(DoorState state) {
+  return state == DOOR_CLOSE ? "CLOSE" : "OPEN";
+}
+
+const char* lockStateToString(LockState state) {
+  switch (state) {
+    case LOCK_LOCKED:   return "LOCKED";
+    case LOCK_UNLOCKED: return "UNLOCKED";
+    default:            return "UNKNOWN";
+  }
+}
+
+const char* accessSourceToString(AccessSource source) {
+  switch (source) {
+    case ACCESS_NFC:    return "NFC";
+    case ACCESS_UDP:    return "UDP";
+    case ACCESS_AWS:    return "AWS";
+    case ACCESS_AUTO:   return "AUTO";
+    case ACCESS_SENSOR: return "SENSOR";
+    default:            return "UNKNOWN";
+  }
+}
+
+const char* nfcStatusToString(NFCStatus status) {
+  switch (status) {
+    case NFC_OK:    return "OK";
+    case NFC_ERROR: return "ERROR";
+    default:        return "DISABLED";
+  }
+}
+
+// 現在状態をJSON1行で構築
+String buildStateJson() {
+  String json = "{\"type\":\"state\",\"mode\":\"";
+  json += modeToString(currentMode);
+  json += "\",\"door\":\"";
+  json += doorStateToString(doorState);
+  json += "\",\"lock\":\"";
+  json += lockStateToString(lockState);
+  json += "\",\"nfc\":\"";
+  json += nfcStatusToString(nfcReader.getStatus());
+  json += "\",\"lastCard\":";
+  StatusServer::appendJsonString(json, lastNfcCardMasked);
+  json += ",\"lastCardType\":\"";
+  json += NFCReader::cardTypeToString(lastNfcCardType);
+  json += "\"}";
+  return json;
+}
+
+// LANクライアントへ状態を反映
+void pushState() {
+  statusServer.setState(buildStateJson());
+}
+
+// LANクライアントへイベントを送信
+void pushEvent(const char* event, const String& fields = "") {
+  String json = "{\"type\":\"event\",\"event\":\"";
+  json += event;
+  json += "\",\"uptime\":";
+  json += String(millis());
+  json += fields;
+  json += "}";
+  statusServer.broadcast(json);
+}
+
+// モード遷移（待機モードに入る場合はタイマーをリセット）
+void enterMode(SystemMode mode) {
+  currentMode = mode;
+  if (mode == WAITING_MODE) {
+    modeStartTime = millis();
+    hasSeenOpenInWaitingMode = false;
+  }
+  pushEvent("mode", String(",\"mode\":\"") + modeToString(mode) + "\"");
+  pushState();
+  
+  TelemetryEvent ev = makeTelemetryEvent(TEV_MODE);
+  ev.value = mode;
+  ev.fields |= TF_VALUE;
+  recordTelemetry(ev);
 }
 
 // Pushover通知を送信
-void sendPushoverNotification(String message) {
+void sendPushoverNotification(const String& message, int priority) {
   // WiFi接続チェック
   if (WiFi.status() != WL_CONNECTED) {
     Serial.println("[Pushover] WiFi not connected, skipping notification");
@@ -105,7 +310,8 @@ void sendPushoverNotification(String message) {
   String postData = "token=" + String(PUSHOVER_API_TOKEN) +
                     "&user=" + String(PUSHOVER_USER_KEY) +
                     "&message=" + message +
-                    "&title=スマートロック";
+                    "&title=スマートロック" +
+                    "&priority=" + String(priority);
   int httpCode = http.POST(postData);
   if (httpCode > 0) {
     Serial.printf("[Pushover] POST code: %d\n", httpCode);
@@ -121,9 +327,15 @@ void sendPushoverNotification(String message) {
   http.end();
 }
 
+// 通知ポリシー（関連イベントをまとめてPushoverへ送信）
+Notifier notifier(sendPushoverNotification);
 
-// サーボでドアを開ける
-void openDoor(AccessSource source = ACCESS_AWS, const String& cardName = "") {
+
+// サーボでドアを開ける（requestedAt: カード検知・コマンド受信時刻、0なら呼び出し時刻）
+void openDoor(AccessSource source = ACCESS_AWS, const char* cardName = "", unsigned long requestedAt = 0) {
+  if (requestedAt == 0) {
+    requestedAt = millis();
+  }
   myServo.write(90);
   delay(MOVE_DELAY);
   myServo.write(155);
@@ -131,33 +343,31 @@ void openDoor(AccessSource source = ACCESS_AWS, const String& cardName = "") {
   myServo.write(90);
   delay(MOVE_DELAY);
   
-  String logMsg = "Door opened";
-  String notificationMsg = "ロックを解除しました";
+  lockState = LOCK_UNLOCKED;
+  pushEvent("lock", String(",\"lock\":\"UNLOCKED\",\"source\":\"") + accessSourceToString(source) + "\"");
+  pushState();
+  
+  TelemetryEvent ev = makeTelemetryEvent(TEV_UNLOCK);
+  ev.source = source;
+  ev.durationMs = millis() - requestedAt;
+  ev.fields |= TF_SOURCE | TF_DURATION_MS;
+  recordTelemetry(ev);
   
   // アクセス経路に応じてメッセージを変更
-  switch (source) {
-    case ACCESS_NFC:
-      logMsg += " via NFC: " + cardName;
-      notificationMsg += "\n経路: NFC (" + cardName + ")";
-      break;
-    case ACCESS_UDP:
-      logMsg += " via UDP";
-      notificationMsg += "\n経路: UDP";
-      break;
-    case ACCESS_AWS:
-      logMsg += " via AWS IoT";
-      notificationMsg += "\n経路: AWS IoT";
-      break;
-    default:
-      break;
-  }
+  char logMsg[ACCESS_MESSAGE_SIZE];
+  char notificationMsg[ACCESS_MESSAGE_SIZE];
+  formatAccessLog(logMsg, sizeof(logMsg), true, source, cardName);
+  formatAccessNotification(notificationMsg, sizeof(notificationMsg), true, source, cardName);
   
   publishLog(logMsg);
-  sendPushoverNotification(notificationMsg);
+  // コマンド経由（特にUDPは認証なし）の解錠は、帰宅時のまとめ通知に混ぜずにすぐ知らせる
+  bool remote = source == ACCESS_UDP || source == ACCESS_AWS;
+  notifier.notify(remote ? NOTIFY_REMOTE_UNLOCK : NOTIFY_UNLOCK, notificationMsg);
 }
 
 // サーボでドアを閉める
-void closeDoor(AccessSource source = ACCESS_AWS, const String& cardName = "") {
+void closeDoor(AccessSource source = ACCESS_AWS, const char* cardName = "") {
+  unsigned long startTime = millis();
   myServo.write(90);
   delay(MOVE_DELAY);
   myServo.write(15);
@@ -165,53 +375,81 @@ void closeDoor(AccessSource source = ACCESS_AWS, const String& cardName = "") {
   myServo.write(90);
   delay(MOVE_DELAY);
   
-  String logMsg = "Door closed";
-  String notificationMsg = "ロックをかけました";
+  lockState = LOCK_LOCKED;
+  pushEvent("lock", String(",\"lock\":\"LOCKED\",\"source\":\"") + accessSourceToString(source) + "\"");
+  pushState();
+  
+  TelemetryEvent ev = makeTelemetryEvent(TEV_LOCK);
+  ev.source = source;
+  ev.durationMs = millis() - startTime;
+  ev.fields |= TF_SOURCE | TF_DURATION_MS;
+  recordTelemetry(ev);
   
   // アクセス経路に応じてメッセージを変更
-  switch (source) {
-    case ACCESS_AUTO:
-      logMsg += " (auto)";
-      notificationMsg += "\n経路: 自動";
-      break;
-    case ACCESS_UDP:
-      logMsg += " via UDP";
-      notificationMsg += "\n経路: UDP";
-      break;
-    case ACCESS_AWS:
-      logMsg += " via AWS IoT";
-      notificationMsg += "\n経路: AWS IoT";
-      break;
-    default:
-      break;
-  }
+  char logMsg[ACCESS_MESSAGE_SIZE];
+  char notificationMsg[ACCESS_MESSAGE_SIZE];
+  formatAccessLog(logMsg, sizeof(logMsg), false, source, cardName);
+  formatAccessNotification(notificationMsg, sizeof(notificationMsg), false, source, cardName);
   
   publishLog(logMsg);
-  sendPushoverNotification(notificationMsg);
+  notifier.notify(NOTIFY_LOCK, notificationMsg);
+}
+
+// NFC検知方式ごとの1周期あたりの所要時間をログに送信
+void publishNfcPollStats() {
+  String msg = "NFC poll stats (current: ";
+  msg += NFCReader::detectModeToString(nfcReader.getDetectMode());
+  msg += ")";
+  const NFCDetectMode modes[] = { NFC_DETECT_SEQUENTIAL, NFC_DETECT_AUTOPOLL };
+  for (NFCDetectMode mode : modes) {
+    const NFCPollStats& stats = nfcReader.getPollStats(mode);
+    if (stats.cycles == 0) {
+      continue;
+    }
+    msg += String(" ") + NFCReader::detectModeToString(mode) + ": cards=" + String(stats.detections);
+    if (stats.detections > 0) {
+      msg += " detect avg=" + String(stats.totalDetectUs / stats.detections / 1000) + "ms max=" +
+             String(stats.maxDetectUs / 1000) + "ms";
+    }
+    msg += " block avg=" + String(stats.totalUs / stats.cycles) + "us max=" + String(stats.maxUs) + "us;";
+  }
+  publishLog(msg);
 }
 
 // コマンド処理
-void handleCommand(const String& payload, AccessSource source) {
-  String cmd = payload;
-  cmd.trim();
+void handleCommand(LockCommand cmd, AccessSource source) {
+  unsigned long receivedAt = millis();
   
-  if (cmd == "openlock") {
-    openDoor(source);
-    currentMode = WAITING_MODE;
-    modeStartTime = millis();
-    hasSeenOpenInWaitingMode = false;
+  TelemetryEvent ev = makeTelemetryEvent(TEV_COMMAND);
+  ev.source = source;
+  ev.value = cmd;
+  ev.fields |= TF_SOURCE | TF_VALUE;
+  recordTelemetry(ev);
+  
+  if (cmd == CMD_OPENLOCK) {
+    openDoor(source, "", receivedAt);
+    enterMode(WAITING_MODE);
     publishLog("Command: openlock, switched to WAITING_MODE");
   } 
-  else if (cmd == "closelock") {
+  else if (cmd == CMD_CLOSELOCK) {
     closeDoor(source);
     publishLog("Command: closelock");
   }
+  else if (cmd == CMD_NFC_SEQUENTIAL || cmd == CMD_NFC_AUTOPOLL) {
+    // 切り替え前の方式の計測結果を残してから切り替える
+    publishNfcPollStats();
+    nfcReader.setDetectMode(cmd == CMD_NFC_AUTOPOLL ? NFC_DETECT_AUTOPOLL : NFC_DETECT_SEQUENTIAL);
+    publishLog(String("Command: nfcmode ") + NFCReader::detectModeToString(nfcReader.getDetectMode()));
+  }
+  else if (cmd == CMD_NFC_STATS) {
+    publishNfcPollStats();
+  }
 }
 
 // MQTT受信コールバック
 void onMqttMessage(String &topic, String &payload) {
   Serial.printf("[MQTT] Topic: %s, Payload: %s\n", topic.c_str(), payload.c_str());
-  handleCommand(payload, ACCESS_AWS);
+  handleCommand(parseCommand(payload.c_str(), payload.length()), ACCESS_AWS);
 }
 
 // WiFi/MQTT管理タスク（Core 0で並列実行）
@@ -220,15 +458,10 @@ void wifiMaintainTask(void* parameter) {
     // WiFi接続チェック
     if (WiFi.status() != WL_CONNECTED) {
       isWifiReconnecting = true;
-      Serial.println("[WiFi] Reconnecting...");
-      
-      WiFi.disconnect();
-      WiFi.begin(WIFI_SSID, WIFI_PASS);
       
-      unsigned long startAttempt = millis();
-      while (WiFi.status() != WL_CONNECTED && millis() - startAttempt < WIFI_RECONNECT_TIMEOUT) {
-        delay(500);
-      }
+      // 切断ごとに復旧ステップを1段ずつ進める（再接続→無線再起動→再起動）
+      supervisor.reportFailure(FAULT_WIFI);
+      supervisor.poll(FAULT_WIFI);
       
       if (WiFi.status() == WL_CONNECTED) {
         Serial.println("[WiFi] Reconnected");
@@ -239,28 +472,28 @@ void wifiMaintainTask(void* parameter) {
         Serial.println("[UDP] Restarted");
         
         publishLog("WiFi reconnected");
-        wifiErrorCount = 0;
+        recordTelemetry(makeTelemetryEvent(TEV_WIFI_RECONNECTED));
       } else {
         Serial.println("[WiFi] Reconnection failed");
-        wifiErrorCount++;
-        
-        // 連続エラーが多い場合は再起動
-        if (wifiErrorCount >= MAX_ERROR_COUNT) {
-          Serial.println("[WiFi] Too many errors, restarting...");
-          delay(2000);
-          ESP.restart();
-        }
       }
       
       isWifiReconnecting = false;
     } else {
-      wifiErrorCount = 0;
+      supervisor.reportHealthy(FAULT_WIFI);
       
       // MQTT接続チェック
       if (!client.connected()) {
         if (client.connect(THINGNAME)) {
           client.subscribe(topicSub);
           publishLog("Connected to AWS IoT");
+          recordTelemetry(makeTelemetryEvent(TEV_MQTT_CONNECTED));
+          
+          // WiFi復旧の報告はMQTT切断中に失われるため、再接続時に統計を送る
+          if (supervisor.getFaultCount(FAULT_WIFI) > 0) {
+            publishLog("WiFi recovery stats: faults=" + String(supervisor.getFaultCount(FAULT_WIFI)) +
+                       " last=" + String(supervisor.getLastRecoveryMs(FAULT_WIFI)) + " ms" +
+                       " max=" + String(supervisor.getMaxRecoveryMs(FAULT_WIFI)) + " ms");
+          }
         }
       }
     }
@@ -270,39 +503,123 @@ void wifiMaintainTask(void* parameter) {
   }
 }
 
+// LAN向け状態配信タスク（Core 0で並列実行、loopがサーボ動作等で止まっていても問い合わせに応答する）
+void statusServerTask(void* parameter) {
+  statusServer.run();
+}
+
 // UDP受信処理
 void processUdp() {
   int packetSize = udpControl.parsePacket();
   if (packetSize > 0) {
-    char buffer[256];
+    char buffer[UDP_PACKET_BUF_SIZE];
     int len = udpControl.read(buffer, sizeof(buffer) - 1);
     if (len > 0) {
-      buffer[len] = '\0';
-      String payload(buffer);
-      Serial.println("[UDP] " + payload);
-      handleCommand(payload, ACCESS_UDP);
+      LockCommand cmd = parseUdpPacket(buffer, len, sizeof(buffer));
+      Serial.print("[UDP] ");
+      Serial.println(buffer);
+      handleCommand(cmd, ACCESS_UDP);
     }
   }
 }
 
-// カードID照合
-bool isCardAllowed(const String& cardID) {
-  for (int i = 0; i < ALLOWED_CARD_COUNT; i++) {
-    if (cardID == ALLOWED_CARD_IDS[i]) {
-      return true;
-    }
+// 復旧ステップ：NFC
+bool recoverNfcBusClear() {
+  return nfcReader.clearBus();
+}
+
+bool recoverNfcReset() {
+  return nfcReader.softReset();
+}
+
+bool recoverNfcReboot() {
+  Serial.println("[NFC] Recovery failed, restarting...");
+  notifier.notify(NOTIFY_NFC_ERROR, "NFCモジュールの異常のため再起動します");
+  notifier.flush();
+  M5.Display.clear();
+  M5.Display.setTextColor(RED);
+  M5.Display.println("NFC ERROR");
+  M5.Display.println("Restarting...");
+  delay(2000);
+  ESP.restart();
+  return false;
+}
+
+const RecoveryStep NFC_RECOVERY_STEPS[] = {
+  { "I2C bus clear",  recoverNfcBusClear, NFC_BUS_CLEAR_SETTLE },
+  { "PN532 reset",    recoverNfcReset,    NFC_RESET_SETTLE },
+  { "PN532 reset",    recoverNfcReset,    NFC_RESET_SETTLE },
+  { "reboot",         recoverNfcReboot,   0 }
+};
+
+// 復旧ステップ：WiFi
+bool waitWifiConnected() {
+  unsigned long startAttempt = millis();
+  while (WiFi.status() != WL_CONNECTED && millis() - startAttempt < WIFI_RECONNECT_TIMEOUT) {
+    delay(500);
   }
+  return WiFi.status() == WL_CONNECTED;
+}
+
+bool recoverWifiReconnect() {
+  Serial.println("[WiFi] Reconnecting...");
+  WiFi.disconnect();
+  WiFi.begin(WIFI_SSID, WIFI_PASS);
+  return waitWifiConnected();
+}
+
+bool recoverWifiRadioRestart() {
+  Serial.println("[WiFi] Restarting radio...");
+  WiFi.disconnect(true);
+  WiFi.mode(WIFI_OFF);
+  delay(500);
+  WiFi.mode(WIFI_STA);
+  WiFi.begin(WIFI_SSID, WIFI_PASS);
+  return waitWifiConnected();
+}
+
+bool recoverWifiReboot() {
+  Serial.println("[WiFi] Recovery failed, restarting...");
+  delay(2000);
+  ESP.restart();
   return false;
 }
 
-// カードIDから名前を取得
-String getCardName(const String& cardID) {
-  for (int i = 0; i < ALLOWED_CARD_COUNT; i++) {
-    if (cardID == ALLOWED_CARD_IDS[i]) {
-      return String(ALLOWED_CARD_NAMES[i]);
-    }
+const RecoveryStep WIFI_RECOVERY_STEPS[] = {
+  { "reconnect",      recoverWifiReconnect,    0 },
+  { "reconnect",      recoverWifiReconnect,    0 },
+  { "radio restart",  recoverWifiRadioRestart, 0 },
+  { "radio restart",  recoverWifiRadioRestart, 0 },
+  { "reboot",         recoverWifiReboot,       0 }
+};
+
+// 障害検知の報告
+void onFaultDetected(FaultClass fault, unsigned int consecutiveFailures) {
+  // NFCはloopから報告される。WiFiは管理タスクから報告され、切断中は通知も送れないのでログのみ
+  if (fault != FAULT_NFC) {
+    return;
   }
-  return "不明なカード";
+  publishLog("NFC fault detected: " + String(consecutiveFailures) + " consecutive poll failures");
+  // 高優先度で即時送信（復旧を繰り返す場合の連続分は通知側の間隔制限でまとめる）
+  notifier.notify(NOTIFY_NFC_ERROR, "NFCモジュールの異常を検知しました（自動復旧中）");
+}
+
+// 復旧時間の報告
+void onFaultRecovered(FaultClass fault, const char* stepName, unsigned long recoveryMs) {
+  publishLog(String(FaultSupervisor::faultToString(fault)) + " recovered in " + String(recoveryMs) +
+             " ms (step: " + stepName + ", faults: " + String(supervisor.getFaultCount(fault)) +
+             ", max: " + String(supervisor.getMaxRecoveryMs(fault)) + " ms)");
+  
+  TelemetryEvent ev = makeTelemetryEvent(TEV_FAULT_RECOVERED);
+  ev.value = fault;
+  ev.durationMs = recoveryMs;
+  ev.fields |= TF_VALUE | TF_DURATION_MS;
+  recordTelemetry(ev);
+}
+
+// カード認証用の乱数（RF有効時はハードウェア乱数）
+void fillCardRandom(uint8_t* out, size_t len) {
+  esp_fill_random(out, len);
 }
 
 // NFC処理（ポーリング間隔を設けて高速化）
@@ -314,43 +631,132 @@ void processNfc() {
   }
   lastNfcCheck = millis();
   
-  NFCStatus nfcStatus = nfcReader.getStatus();
-  if (nfcStatus == NFC_ERROR) {
-    nfcErrorCount++;
-    
-    // 連続エラーが多い場合は再起動
-    if (nfcErrorCount >= MAX_ERROR_COUNT) {
-      Serial.println("[NFC] Too many errors, restarting...");
-      M5.Display.clear();
-      M5.Display.setTextColor(RED);
-      M5.Display.println("NFC ERROR");
-      M5.Display.println("Restarting...");
-      delay(2000);
-      ESP.restart();
-    }
-    return;
-  } else if (nfcStatus != NFC_OK) {
+  NFCStatus prevStatus = nfcReader.getStatus();
+  if (prevStatus == NFC_DISABLED) {
     return;
   }
   
-  nfcErrorCount = 0; // 正常時はリセット
-  
+  unsigned long pollStart = millis();
   CardType cardType = nfcReader.checkCard();
+  
+  // ポーリング結果から接続状態を判定（専用のヘルスチェックは行わない）
+  if (nfcReader.lastPollFailed()) {
+    supervisor.reportFailure(FAULT_NFC);
+  } else {
+    supervisor.reportHealthy(FAULT_NFC);
+  }
+  supervisor.poll(FAULT_NFC);
+  
+  if (nfcReader.getStatus() != prevStatus) {
+    pushState();
+  }
+  
   if (cardType != CARD_NONE) {
-    String cardID = nfcReader.getLastCardID();
+    const char* cardID = nfcReader.getLastCardID();
     lastNfcCardID = cardID;
+    char maskedID[CARD_ID_BUF_SIZE];
+    maskCardId(cardID, maskedID);
+    lastNfcCardMasked = maskedID;
     lastNfcCardType = cardType;
     
-    // カードID照合
-    if (isCardAllowed(cardID)) {
-      String cardName = getCardName(cardID);
-      publishLog("Card accepted: " + String(NFCReader::cardTypeToString(cardType)) + " ID=" + cardID);
-      openDoor(ACCESS_NFC, cardName);
-      currentMode = WAITING_MODE;
-      modeStartTime = millis();
-      hasSeenOpenInWaitingMode = false;
+    // カードID照合（1回の検索で可否と名前を取得）
+    int cardIndex = findCardIndex(ALLOWED_CARD_IDS, ALLOWED_CARD_COUNT, cardID);
+    bool allowed = cardIndex >= 0;
+    
+    // 認証情報が登録されたカードは鍵による認証も必須（UIDだけ複製したカードを拒否）
+    const CardAuthCredential* credential = allowed
+        ? findCardCredential(CARD_AUTH_CREDENTIALS, CARD_AUTH_CREDENTIAL_COUNT, cardID) : nullptr;
+    CardAuthResult authResult = CARD_AUTH_OK;
+    unsigned long authUs = 0;
+    if (credential != nullptr) {
+      unsigned long authStart = micros();
+      authResult = cardAuthenticate(*credential, NFCReader::transceive, &nfcReader, fillCardRandom);
+      authUs = micros() - authStart;
+      allowed = authResult == CARD_AUTH_OK;
+      
+      if (authResult == CARD_AUTH_LINK_ERROR) {
+        if (lastNfcCardID == linkErrorCardID) {
+          linkErrorCount++;
+        } else {
+          linkErrorCardID = lastNfcCardID;
+          linkErrorCount = 1;
+        }
+        
+        // 再ポーリングで同じカードを選択し直せたら、一時的な通信エラーとみなして1回だけ認証をやり直す
+        // やり直しも失敗すれば拒否する（ISO-DEPに応答しないUID複製カード等）
+        bool present = nfcReader.isLastCardPresent();
+        if (present) {
+          authResult = cardAuthenticate(*credential, NFCReader::transceive, &nfcReader, fillCardRandom);
+          authUs = micros() - authStart;
+          allowed = authResult == CARD_AUTH_OK;
+        }
+        
+        // 見つからなければ認証途中でカードが離れただけなので次のポーリングで再試行する（何度も繰り返す場合は拒否）
+        if (!present && linkErrorCount < CARD_AUTH_LINK_ERROR_LIMIT) {
+          nfcReader.forgetLastCard();
+          if (millis() - lastLinkErrorLog >= CARD_AUTH_LINK_LOG_INTERVAL) {
+            String msg = "Card auth interrupted: ID=" + lastNfcCardID;
+            if (suppressedLinkErrorLogs > 0) {
+              msg += " (+" + String(suppressedLinkErrorLogs) + " suppressed)";
+            }
+            publishLog(msg);
+            lastLinkErrorLog = millis();
+            suppressedLinkErrorLogs = 0;
+          } else {
+            suppressedLinkErrorLogs++;
+          }
+          return;
+        }
+      }
+      // 認証の結果が出たら（拒否を含む）数え直す
+      linkErrorCardID = "";
+      linkErrorCount = 0;
+    }
+    
+    // LANクライアントへ即時通知
+    String fields = ",\"result\":\"";
+    fields += allowed ? "accepted" : "rejected";
+    fields += "\",\"cardType\":\"";
+    fields += NFCReader::cardTypeToString(cardType);
+    fields += "\",\"id\":";
+    StatusServer::appendJsonString(fields, lastNfcCardMasked);
+    if (allowed) {
+      fields += ",\"name\":";
+      StatusServer::appendJsonString(fields, ALLOWED_CARD_NAMES[cardIndex]);
+    }
+    if (credential != nullptr) {
+      fields += ",\"auth\":\"";
+      fields += cardAuthResultToString(authResult);
+      fields += "\"";
+    }
+    pushEvent("nfc", fields);
+    pushState();
+    
+    TelemetryEvent ev = makeTelemetryEvent(allowed ? TEV_CARD_ACCEPTED : TEV_CARD_REJECTED);
+    ev.cardType = cardType;
+    ev.fields |= TF_CARD_TYPE;
+    telemetrySetUidHex(&ev, cardID);
+    if (credential != nullptr) {
+      ev.value = authResult;
+      ev.durationMs = authUs / 1000;
+      ev.fields |= TF_VALUE | TF_DURATION_MS;
+    }
+    recordTelemetry(ev);
+    
+    if (allowed) {
+      String msg = "Card accepted: " + String(NFCReader::cardTypeToString(cardType)) + " ID=" + lastNfcCardID;
+      if (credential != nullptr) {
+        msg += " auth=" + String(authUs) + "us";
+      }
+      publishLog(msg);
+      openDoor(ACCESS_NFC, ALLOWED_CARD_NAMES[cardIndex], pollStart);
+      enterMode(WAITING_MODE);
+    } else if (credential != nullptr) {
+      publishLog("Card auth failed: " + String(cardAuthResultToString(authResult)) + " ID=" + lastNfcCardID);
+      notifier.notify(NOTIFY_REJECTED, "カードの認証に失敗しました（複製カードの可能性）\nID: " + lastNfcCardID);
     } else {
-      publishLog("Card rejected: " + String(NFCReader::cardTypeToString(cardType)) + " ID=" + cardID);
+      publishLog("Card rejected: " + String(NFCReader::cardTypeToString(cardType)) + " ID=" + lastNfcCardID);
+      notifier.notify(NOTIFY_REJECTED, "未登録のカードを検知しました\nID: " + lastNfcCardID);
     }
   }
 }
@@ -358,6 +764,7 @@ void processNfc() {
 void setup() {
   auto cfg = M5.config();
   M5.begin(cfg);
+  bootId = esp_random();
   M5.Lcd.setRotation(2);
 
   // サーボ初期化
@@ -385,8 +792,19 @@ void setup() {
   M5.Display.println("Sensor OK");
   delay(500);
 
+  // 段階的復旧の設定
+  supervisor.setSteps(FAULT_NFC, NFC_RECOVERY_STEPS,
+                      sizeof(NFC_RECOVERY_STEPS) / sizeof(NFC_RECOVERY_STEPS[0]), MAX_ERROR_COUNT,
+                      NFC_RECOVERY_HOLD);
+  supervisor.setSteps(FAULT_WIFI, WIFI_RECOVERY_STEPS,
+                      sizeof(WIFI_RECOVERY_STEPS) / sizeof(WIFI_RECOVERY_STEPS[0]), 1,
+                      WIFI_RECOVERY_HOLD);
+  supervisor.setDetectedReporter(onFaultDetected);
+  supervisor.setReporter(onFaultRecovered);
+
   // NFC初期化
   M5.Display.println("NFC...");
+  nfcReader.setDetectMode(NFC_DEFAULT_DETECT_MODE);
   bool nfcOk = nfcReader.begin(3);
   if (nfcOk) {
     M5.Display.println("NFC OK");
@@ -404,9 +822,28 @@ void setup() {
   }
   M5.Display.println("WiFi OK");
 
+  // 時刻同期（SNTP、バックグラウンドで同期される）
+  configTime(0, 0, "pool.ntp.org", "time.google.com");
+
   // UDP開始
   udpControl.begin(UDP_PORT);
 
+  // 通知のまとめ時間：待機モード中の一連の動作（解錠→開扉→自動施錠）が1通に収まるように
+  notifier.setWindow(WAITING_TIMEOUT, WAITING_TIMEOUT * 2);
+
+  // LAN向け状態配信サーバ開始（ソケットの処理は専用タスクで行う）
+  statusServer.begin();
+  pushState();
+  xTaskCreatePinnedToCore(
+    statusServerTask,   // タスク関数
+    "StatusServer",     // タスク名
+    4096,               // スタックサイズ
+    NULL,               // パラメータ
+    1,                  // 優先度
+    &statusTaskHandle,  // タスクハンドル
+    0                   // Core 0で実行
+  );
+
   // AWS IoT Core接続
   wifi_s.setCACert(AWS_CERT_CA);
   wifi_s.setCertificate(AWS_CERT_CRT);
@@ -435,6 +872,7 @@ void setup() {
   M5.Display.println("Ready!");
   delay(1000);
   publishLog("System started");
+  recordTelemetry(makeTelemetryEvent(TEV_BOOT));
 }
 
 // ディスプレイ更新
@@ -478,7 +916,9 @@ void updateDisplay() {
   M5.Display.setCursor(0, M5.Display.height() - 40);
   
   NFCStatus nfcStatus = nfcReader.getStatus();
-  if (nfcStatus == NFC_OK) {
+  if (supervisor.isFaulted(FAULT_NFC)) {
+    M5.Display.println("NFC: RECOVERING");
+  } else if (nfcStatus == NFC_OK) {
     M5.Display.println("NFC: OK");
   } else if (nfcStatus == NFC_ERROR) {
     M5.Display.println("NFC: ERROR");
@@ -500,14 +940,7 @@ void updateDisplay() {
 void loop() {
   M5.update();
 
-  // NFC接続維持
-  static unsigned long lastNfcConnectionCheck = 0;
-  if (millis() - lastNfcConnectionCheck > NFC_CONNECTION_CHECK_INTERVAL) {
-    nfcReader.ensureConnection();
-    lastNfcConnectionCheck = millis();
-  }
-
-  // UDP受信とMQTTメッセージ処理
+  // UDP受信・MQTTメッセージ処理（LANクライアントはStatusServerタスクが処理）
   processUdp();
   client.loop();
   
@@ -517,12 +950,10 @@ void loop() {
   // ボタン処理
   if (M5.BtnA.wasPressed()) {
     if (currentMode == NORMAL) {
-      currentMode = WAITING_MODE;
-      modeStartTime = millis();
-      hasSeenOpenInWaitingMode = false;
+      enterMode(WAITING_MODE);
       publishLog("Button pressed: switched to WAITING_MODE");
     } else {
-      currentMode = NORMAL;
+      enterMode(NORMAL);
       publishLog("Button pressed: switched to NORMAL");
     }
   }
@@ -531,27 +962,33 @@ void loop() {
   VL53L0X_RangingMeasurementData_t measure;
   lox.rangingTest(&measure, false);
 
-  bool isCurrentlyClose = (measure.RangeStatus != 4 && measure.RangeMilliMeter < 40);
+  // ドア状態判定（フィルタ・ヒステリシス・信号強度による選別）
+  float signalRateMcps = measure.SignalRateRtnMegaCps / 65536.0f;
+  doorDetector.update(millis(), measure.RangeMilliMeter, measure.RangeStatus, signalRateMcps);
+  lastDoorState = doorState;
+  doorState = doorDetector.getState();
 
-  // ドア状態判定（デバウンス）
-  if (isCurrentlyClose) {
-    if (doorCloseStartTime == 0) {
-      doorCloseStartTime = millis();
-    } else if (millis() - doorCloseStartTime >= DOOR_DEBOUNCE_TIME) {
-      lastDoorState = doorState;
-      doorState = DOOR_CLOSE;
-    }
-  } else {
-    doorCloseStartTime = 0;
-    lastDoorState = doorState;
-    doorState = DOOR_OPEN;
+  if (DOOR_SAMPLE_LOG) {
+    Serial.printf("[DOOR] %lu,%u,%u,%.3f,%.1f,%d\n", millis(), measure.RangeMilliMeter,
+                  measure.RangeStatus, signalRateMcps, doorDetector.getFilteredMm(), (int)doorState);
+  }
+
+  // ドア状態の変化をLANクライアントへ通知
+  if (doorState != lastDoorState) {
+    pushEvent("door", String(",\"door\":\"") + doorStateToString(doorState) + "\"");
+    pushState();
+    
+    TelemetryEvent ev = makeTelemetryEvent(TEV_DOOR);
+    ev.value = doorState;
+    ev.fields |= TF_VALUE;
+    recordTelemetry(ev);
   }
 
   // 待機モード処理
   if (currentMode == WAITING_MODE) {
     // タイムアウトチェック
     if (millis() - modeStartTime >= WAITING_TIMEOUT) {
-      currentMode = NORMAL;
+      enterMode(NORMAL);
       publishLog("WAITING_MODE timeout: switched to NORMAL");
     }
 
@@ -559,17 +996,27 @@ void loop() {
     if (doorState == DOOR_OPEN && lastDoorState == DOOR_CLOSE) {
       hasSeenOpenInWaitingMode = true;
       publishLog("Detected CLOSE->OPEN in WAITING_MODE");
-      sendPushoverNotification("玄関ドアが開きました");
+      notifier.notify(NOTIFY_DOOR, "玄関ドアが開きました");
     }
 
     if (doorState == DOOR_CLOSE && lastDoorState == DOOR_OPEN && hasSeenOpenInWaitingMode) {
       closeDoor(ACCESS_AUTO);
-      currentMode = NORMAL;
+      enterMode(NORMAL);
       hasSeenOpenInWaitingMode = false;
       publishLog("Auto-closed door after CLOSE->OPEN->CLOSE");
     }
   }
 
+  // まとめ通知の送信判定
+  notifier.poll();
+
+  // テレメトリ送信
+  static unsigned long lastTelemetryFlush = 0;
+  if (millis() - lastTelemetryFlush >= TELEMETRY_FLUSH_INTERVAL) {
+    flushTelemetry();
+    lastTelemetryFlush = millis();
+  }
+
   // ディスプレイ更新（高速化のため頻度を下げる）
   static unsigned long lastDisplayUpdate = 0;
   if (millis() - lastDisplayUpdate >= DISPLAY_UPDATE_INTERVAL) {
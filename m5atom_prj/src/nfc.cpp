@@ -3,9 +3,25 @@
 #define I2C_SDA_PIN 2
 #define I2C_SCL_PIN 1
 #define CARD_COOLDOWN_MS 2000  // 同じカードの連続読み取り防止
+#define CARD_EXCHANGE_TIMEOUT_MS 100  // InDataExchangeの応答待ち（カード側のAES処理を含む）
 
-NFCReader::NFCReader() : pn532i2c(nullptr), nfc(nullptr), status(NFC_DISABLED), 
-                         lastCardType(CARD_NONE), lastSeenTime(0) {
+// PN532のI2Cアドレス（7ビット）。ライブラリのヘッダでは公開されていない
+#define NFC_PN532_I2C_ADDRESS  0x24
+
+// InAutoPoll（PN532が対象の種類を切り替えながら自律的にポーリングする）
+#define NFC_CMD_INAUTOPOLL     0x60
+#define AUTOPOLL_ROUNDS        0x01  // 全種類を1巡したら結果を返す（空振りの周期を区切って検知までの時間を測るため）
+#define AUTOPOLL_PERIOD        0x01  // 種類ごとのポーリング時間（150ms単位）
+#define AUTOPOLL_TYPE_TYPEA    0x10  // 106kbps ISO14443A (Mifare)
+#define AUTOPOLL_TYPE_FELICA   0x11  // 212kbps FeliCa
+#define AUTOPOLL_TYPE_FELICA4  0x12  // 424kbps FeliCa
+
+NFCReader::NFCReader() : pn532i2c(nullptr), nfc(nullptr), status(NFC_DISABLED), pollFailed(false),
+                         detectMode(NFC_DETECT_SEQUENTIAL), autoPollArmed(false), autoPollArmedUs(0),
+                         cardSeen(false), hasEmptyCycle(false), lastEmptyCycleUs(0),
+                         lastCardType(CARD_NONE), lastTarget(1), debouncer(CARD_COOLDOWN_MS) {
+  lastCardID[0] = '\0';
+  resetPollStats();
 }
 
 bool NFCReader::begin(int maxRetries) {
@@ -21,15 +37,8 @@ bool NFCReader::begin(int maxRetries) {
     nfc->begin();
     delay(100);
     
-    uint32_t ver = nfc->getFirmwareVersion();
-    if (ver) {
+    if (configure()) {
       // 初期化成功
-      Serial.printf("[NFC] PN5%02X FW %d.%d initialized\n", 
-                    (ver>>24)&0xFF, (ver>>16)&0xFF, (ver>>8)&0xFF);
-      
-      nfc->setPassiveActivationRetries(0xFF);
-      nfc->SAMConfig();
-      
       status = NFC_OK;
       return true;
     }
@@ -50,54 +59,248 @@ bool NFCReader::begin(int maxRetries) {
   return false;
 }
 
-bool NFCReader::ensureConnection() {
-  if (status == NFC_DISABLED) {
-    return false;
-  }
+bool NFCReader::configure() {
+  // 他のコマンドを送るとInAutoPollは中断されるので、再度発行が必要
+  autoPollArmed = false;
   
-  // 定期的に接続確認（getFirmwareVersionでチェック）
   uint32_t ver = nfc->getFirmwareVersion();
   if (!ver) {
-    Serial.println("[NFC] Connection lost. Attempting to reconnect...");
-    status = NFC_ERROR;
-    
-    // 再初期化試行
-    delete nfc;
-    delete pn532i2c;
-    
-    if (begin(3)) {
-      Serial.println("[NFC] Reconnected successfully");
-      return true;
-    } else {
-      Serial.println("[NFC] Reconnection failed. NFC disabled.");
-      status = NFC_DISABLED;
-      return false;
-    }
+    return false;
+  }
+  
+  Serial.printf("[NFC] PN5%02X FW %d.%d initialized\n", 
+                (ver>>24)&0xFF, (ver>>16)&0xFF, (ver>>8)&0xFF);
+  
+  nfc->setPassiveActivationRetries(0xFF);
+  nfc->SAMConfig();
+  return true;
+}
+
+bool NFCReader::clearBus() {
+  autoPollArmed = false;
+  Wire.end();
+  
+  // SDAを掴んだままのスレーブを解放させるため、SCLを最大9回空打ち
+  pinMode(I2C_SDA_PIN, INPUT_PULLUP);
+  pinMode(I2C_SCL_PIN, OUTPUT_OPEN_DRAIN);
+  for (int i = 0; i < 9 && digitalRead(I2C_SDA_PIN) == LOW; i++) {
+    digitalWrite(I2C_SCL_PIN, LOW);
+    delayMicroseconds(10);
+    digitalWrite(I2C_SCL_PIN, HIGH);
+    delayMicroseconds(10);
   }
   
-  if (status == NFC_ERROR) {
+  // STOPコンディション送出（SCL=HIGHの間にSDAをLOW→HIGH）
+  pinMode(I2C_SDA_PIN, OUTPUT_OPEN_DRAIN);
+  digitalWrite(I2C_SDA_PIN, LOW);
+  delayMicroseconds(10);
+  digitalWrite(I2C_SCL_PIN, HIGH);
+  delayMicroseconds(10);
+  digitalWrite(I2C_SDA_PIN, HIGH);
+  delayMicroseconds(10);
+  
+  bool released = digitalRead(I2C_SDA_PIN) == HIGH;
+  
+  Wire.begin(I2C_SDA_PIN, I2C_SCL_PIN);
+  Wire.setClock(50000UL);
+  
+  Serial.printf("[NFC] I2C bus cleared (SDA %s)\n", released ? "released" : "still low");
+  // 復旧の確認は次回以降のポーリング結果で行う
+  return false;
+}
+
+bool NFCReader::softReset() {
+  if (nfc == nullptr) {
+    return false;
+  }
+  
+  // 既存のインスタンスを使ってwakeupからやり直す
+  nfc->begin();
+  delay(100);
+  
+  if (configure()) {
     status = NFC_OK;
+    pollFailed = false;
+    return true;
   }
-  return true;
+  
+  Serial.println("[NFC] Soft reset failed");
+  status = NFC_ERROR;
+  return false;
+}
+
+void NFCReader::setDetectMode(NFCDetectMode mode) {
+  if (mode == detectMode) {
+    return;
+  }
+  detectMode = mode;
+  // 次のコマンドで進行中のInAutoPollは中断される
+  autoPollArmed = false;
+  hasEmptyCycle = false;
+  Serial.printf("[NFC] Detect mode: %s\n", detectModeToString(mode));
+}
+
+void NFCReader::resetPollStats() {
+  for (int i = 0; i < 2; i++) {
+    pollStats[i].cycles = 0;
+    pollStats[i].totalUs = 0;
+    pollStats[i].maxUs = 0;
+    pollStats[i].detections = 0;
+    pollStats[i].totalDetectUs = 0;
+    pollStats[i].maxDetectUs = 0;
+  }
+}
+
+const char* NFCReader::detectModeToString(NFCDetectMode mode) {
+  return mode == NFC_DETECT_AUTOPOLL ? "autopoll" : "sequential";
+}
+
+void NFCReader::setPollResult(bool failed) {
+  pollFailed = failed;
+  status = failed ? NFC_ERROR : NFC_OK;
 }
 
 CardType NFCReader::checkCard() {
-  if (status != NFC_OK || nfc == nullptr) {
+  if (status == NFC_DISABLED || nfc == nullptr) {
+    return CARD_NONE;
+  }
+  
+  NFCDetectMode mode = detectMode;
+  cardSeen = false;
+  unsigned long start = micros();
+  CardType result = (mode == NFC_DETECT_AUTOPOLL) ? checkCardAutoPoll() : checkCardSequential();
+  unsigned long now = micros();
+  unsigned long elapsed = now - start;
+  
+  // loopを止めた時間
+  NFCPollStats& stats = pollStats[mode];
+  stats.cycles++;
+  stats.totalUs += elapsed;
+  if (elapsed > stats.maxUs) {
+    stats.maxUs = elapsed;
+  }
+  
+  // 逐次方式は1回の呼び出しが1周期（InAutoPollは応答を読んだ時点で記録）
+  if (mode == NFC_DETECT_SEQUENTIAL) {
+    recordCycle(mode, result, start, now);
+  }
+  return result;
+}
+
+void NFCReader::recordCycle(NFCDetectMode mode, CardType result, unsigned long cycleStartUs, unsigned long nowUs) {
+  if (pollFailed) {
+    // 通信エラーの周期は空振りとみなせない
+    hasEmptyCycle = false;
+    return;
+  }
+  if (result != CARD_NONE) {
+    // 直前の空振り周期の開始 → 検知（カードをかざしてから検知するまでの最大値）
+    // 起動直後からかざしていた等、空振りの周期がなければ数えない
+    if (hasEmptyCycle) {
+      NFCPollStats& stats = pollStats[mode];
+      unsigned long latency = nowUs - lastEmptyCycleUs;
+      stats.detections++;
+      stats.totalDetectUs += latency;
+      if (latency > stats.maxDetectUs) {
+        stats.maxDetectUs = latency;
+      }
+    }
+    hasEmptyCycle = false;
+  } else if (!cardSeen) {
+    // 同じカードの連続読み取り（cardSeen）は空振りに数えない
+    lastEmptyCycleUs = cycleStartUs;
+    hasEmptyCycle = true;
+  }
+}
+
+CardType NFCReader::checkCardAutoPoll() {
+  // 1) 未発行ならInAutoPollを発行（FeliCa 212/424kbps・TypeAをPN532が交互にポーリング）
+  if (!autoPollArmed) {
+    const uint8_t cmd[] = { NFC_CMD_INAUTOPOLL, AUTOPOLL_ROUNDS, AUTOPOLL_PERIOD,
+                            AUTOPOLL_TYPE_FELICA, AUTOPOLL_TYPE_FELICA4, AUTOPOLL_TYPE_TYPEA };
+    // ACKが返らなければ通信エラー
+    autoPollArmedUs = micros();
+    bool failed = pn532i2c->writeCommand(cmd, sizeof(cmd)) != 0;
+    setPollResult(failed);
+    autoPollArmed = !failed;
+    if (failed) {
+      hasEmptyCycle = false;
+    }
+    return CARD_NONE;
+  }
+  
+  // 2) ステータスバイトだけを読んで応答の準備ができたか確認（I2C 1バイト）
+  if (Wire.requestFrom((uint8_t)NFC_PN532_I2C_ADDRESS, (uint8_t)1) != 1) {
+    // アドレスにACKが返らない
+    setPollResult(true);
+    autoPollArmed = false;
+    hasEmptyCycle = false;
+    return CARD_NONE;
+  }
+  uint8_t ready = Wire.read();
+  setPollResult(false);
+  if (!(ready & 0x01)) {
+    return CARD_NONE;
+  }
+  
+  // 3) 応答を読み取り（次の周期で再発行する）。発行から応答までが1周期
+  uint8_t buf[64];
+  int16_t len = pn532i2c->readResponse(buf, sizeof(buf), 10);
+  autoPollArmed = false;
+  if (len < 1) {
+    // 応答が読めなかった周期は空振りとみなせない
+    hasEmptyCycle = false;
     return CARD_NONE;
   }
+  CardType result = parseAutoPollTarget(buf, len);
+  recordCycle(NFC_DETECT_AUTOPOLL, result, autoPollArmedUs, micros());
+  return result;
+}
+
+CardType NFCReader::parseAutoPollTarget(const uint8_t* buf, int16_t len) {
+  // [NbTg] [Type] [Len] [TargetData...]（1巡して見つからなければNbTg = 0）
+  if (len < 3 || buf[0] == 0 || buf[2] > len - 3) {
+    return CARD_NONE;
+  }
+  
+  uint8_t type = buf[1];
+  uint8_t targetLen = buf[2];
+  const uint8_t* target = buf + 3;
   
+  if (type == AUTOPOLL_TYPE_FELICA || type == AUTOPOLL_TYPE_FELICA4) {
+    // Tg, POL_RES長, 応答コード(0x01), IDm(8), PMm(8), [システムコード(2)]
+    if (targetLen >= 11 && acceptCard(CARD_FELICA, target + 3, 8)) {
+      return CARD_FELICA;
+    }
+  } else if (type == AUTOPOLL_TYPE_TYPEA) {
+    // Tg, SENS_RES(2), SEL_RES(1), UID長, UID...
+    if (targetLen >= 5) {
+      uint8_t uidLen = target[4];
+      if (uidLen > 0 && 5 + uidLen <= targetLen && acceptCard(CARD_TYPEA, target + 5, uidLen)) {
+        lastTarget = target[0];
+        return CARD_TYPEA;
+      }
+    }
+  }
+  return CARD_NONE;
+}
+
+CardType NFCReader::checkCardSequential() {
   // 1) FeliCa検知（タイムアウト短縮：10ms）
   {
     uint8_t idm[8], pmm[8];
     uint16_t sysCodeResp = 0;
-    uint8_t ok = nfc->felica_Polling(0xFFFF, 0x01, idm, pmm, &sysCodeResp, 10);
+    int8_t ok = nfc->felica_Polling(0xFFFF, 0x01, idm, pmm, &sysCodeResp, 10);
+    
+    // -1はコマンドにACKが返らなかった場合（カードなしのタイムアウトは-2）
+    // これを通信エラーとして扱い、別途ヘルスチェックは行わない
+    setPollResult(ok == -1);
+    if (pollFailed) {
+      return CARD_NONE;
+    }
     
     if (ok == 1) {
-      String cardID = bytesToHexString(idm, 8);
-      if (!isSameCard(CARD_FELICA, cardID)) {
-        lastCardID = cardID;
-        lastCardType = CARD_FELICA;
-        lastSeenTime = millis();
+      if (acceptCard(CARD_FELICA, idm, 8)) {
         return CARD_FELICA;
       }
     }
@@ -110,11 +313,9 @@ CardType NFCReader::checkCard() {
     bool ok = nfc->readPassiveTargetID(PN532_MIFARE_ISO14443A, uid, &uidLen, 10);
     
     if (ok && uidLen > 0) {
-      String cardID = bytesToHexString(uid, uidLen);
-      if (!isSameCard(CARD_TYPEA, cardID)) {
-        lastCardID = cardID;
-        lastCardType = CARD_TYPEA;
-        lastSeenTime = millis();
+      if (acceptCard(CARD_TYPEA, uid, uidLen)) {
+        // InListPassiveTargetで検知した1枚目
+        lastTarget = 1;
         return CARD_TYPEA;
       }
     }
@@ -123,33 +324,85 @@ CardType NFCReader::checkCard() {
   return CARD_NONE;
 }
 
-String NFCReader::getLastCardID() {
+const char* NFCReader::getLastCardID() const {
   return lastCardID;
 }
 
-bool NFCReader::isSameCard(CardType type, const String& id) {
-  if (type != lastCardType) {
+void NFCReader::forgetLastCard() {
+  debouncer.clear();
+}
+
+bool NFCReader::isLastCardPresent() {
+  if (status == NFC_DISABLED || nfc == nullptr) {
     return false;
   }
-  if (id != lastCardID) {
+  
+  uint8_t id[CARD_ID_MAX_BYTES] = {0};
+  uint8_t idLen = 0;
+  if (lastCardType == CARD_FELICA) {
+    uint8_t pmm[8];
+    uint16_t sysCodeResp = 0;
+    if (nfc->felica_Polling(0xFFFF, 0x01, id, pmm, &sysCodeResp, 10) != 1) {
+      return false;
+    }
+    idLen = 8;
+  } else if (lastCardType == CARD_TYPEA) {
+    if (!nfc->readPassiveTargetID(PN532_MIFARE_ISO14443A, id, &idLen, 10) || idLen == 0) {
+      return false;
+    }
+    // 選択し直したのでターゲット番号も1枚目に戻る
+    lastTarget = 1;
+  } else {
     return false;
   }
-  if (millis() - lastSeenTime > CARD_COOLDOWN_MS) {
+  
+  char cardID[CARD_ID_BUF_SIZE];
+  cardBytesToHex(id, idLen > CARD_ID_MAX_BYTES ? CARD_ID_MAX_BYTES : idLen, cardID);
+  return strcmp(cardID, lastCardID) == 0;
+}
+
+bool NFCReader::exchange(const uint8_t* cmd, uint8_t cmdLen, uint8_t* resp, uint8_t* respLen) {
+  if (status == NFC_DISABLED || pn532i2c == nullptr) {
     return false;
   }
+  
+  // ライブラリのinDataExchangeは応答待ちが1秒固定なので、直接コマンドを組み立てる
+  const uint8_t header[] = { PN532_COMMAND_INDATAEXCHANGE, lastTarget };
+  if (pn532i2c->writeCommand(header, sizeof(header), cmd, cmdLen) != 0) {
+    return false;
+  }
+  
+  // [Status] [DataIn...]
+  uint8_t buf[CARD_AUTH_RESP_MAX + 1];
+  int16_t len = pn532i2c->readResponse(buf, sizeof(buf), CARD_EXCHANGE_TIMEOUT_MS);
+  if (len < 1 || (buf[0] & 0x3F) != 0 || len - 1 > *respLen) {
+    return false;
+  }
+  memcpy(resp, buf + 1, len - 1);
+  *respLen = len - 1;
   return true;
 }
 
-String NFCReader::bytesToHexString(const uint8_t* data, uint8_t len) {
-  String result = "";
-  for (uint8_t i = 0; i < len; i++) {
-    if (data[i] < 0x10) {
-      result += "0";
-    }
-    result += String(data[i], HEX);
+bool NFCReader::transceive(void* ctx, const uint8_t* cmd, uint8_t cmdLen, uint8_t* resp, uint8_t* respLen) {
+  return static_cast<NFCReader*>(ctx)->exchange(cmd, cmdLen, resp, respLen);
+}
+
+bool NFCReader::acceptCard(CardType type, const uint8_t* data, uint8_t len) {
+  char cardID[CARD_ID_BUF_SIZE];
+  if (len > CARD_ID_MAX_BYTES) {
+    len = CARD_ID_MAX_BYTES;
   }
-  result.toUpperCase();
-  return result;
+  cardBytesToHex(data, len, cardID);
+  cardSeen = true;
+  
+  unsigned long now = millis();
+  if (debouncer.isRepeat(type, cardID, now)) {
+    return false;
+  }
+  debouncer.record(type, cardID, now);
+  memcpy(lastCardID, cardID, sizeof(lastCardID));
+  lastCardType = type;
+  return true;
 }
 
 const char* NFCReader::cardTypeToString(CardType type) {
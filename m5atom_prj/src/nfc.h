@@ -5,6 +5,8 @@
 #include <Wire.h>
 #include <PN532.h>
 #include <PN532_I2C.h>
+#include "access_core.h"
+#include "card_auth.h"
 
 enum NFCStatus {
   NFC_OK,
@@ -18,6 +20,24 @@ enum CardType {
   CARD_TYPEA
 };
 
+// カード検知方式
+enum NFCDetectMode {
+  NFC_DETECT_SEQUENTIAL,  // FeliCa・TypeAを順にホストからポーリング（コマンド2回/周期）
+  NFC_DETECT_AUTOPOLL     // InAutoPollでPN532に交互ポーリングさせ、ホストは応答の有無だけ確認
+};
+
+// 検知方式ごとの統計
+struct NFCPollStats {
+  // checkCard()がloopを止めた時間
+  unsigned long cycles;
+  unsigned long totalUs;
+  unsigned long maxUs;
+  // 検知までの時間（直前の空振り周期の開始から検知まで）
+  unsigned long detections;
+  unsigned long totalDetectUs;
+  unsigned long maxDetectUs;
+};
+
 class NFCReader {
 public:
   NFCReader();
@@ -28,11 +48,39 @@ public:
   // カード検知（戻り値：カードタイプ）
   CardType checkCard();
   
+  // 検知方式の切り替え
+  void setDetectMode(NFCDetectMode mode);
+  NFCDetectMode getDetectMode() const { return detectMode; }
+  
+  // 検知方式ごとの所要時間の統計
+  const NFCPollStats& getPollStats(NFCDetectMode mode) const { return pollStats[mode]; }
+  void resetPollStats();
+  
+  static const char* detectModeToString(NFCDetectMode mode);
+  
   // 最後に読み取ったカードIDを文字列で取得
-  String getLastCardID();
+  const char* getLastCardID() const;
+  
+  // 最後に読み取ったカードを忘れる（直後に同じカードを再度読み取れるようにする）
+  void forgetLastCard();
+  
+  // 最後に読み取ったカードがまだかざされているか（同じ種類で再ポーリングしてIDを比較）
+  bool isLastCardPresent();
   
-  // 接続状態チェック＆再接続
-  bool ensureConnection();
+  // 最後に検知したTypeAカードとAPDUを送受信（InDataExchange、カード認証用）
+  bool exchange(const uint8_t* cmd, uint8_t cmdLen, uint8_t* resp, uint8_t* respLen);
+  
+  // CardTransceiveFunc形式のラッパー（ctxはNFCReader）
+  static bool transceive(void* ctx, const uint8_t* cmd, uint8_t cmdLen, uint8_t* resp, uint8_t* respLen);
+  
+  // 直近のポーリングで通信エラーが起きたか（通常のポーリング結果から判定）
+  bool lastPollFailed() const { return pollFailed; }
+  
+  // 復旧処理：I2Cバスの張り付き解除（SCLを空打ちしてSTOPを送出）
+  bool clearBus();
+  
+  // 復旧処理：PN532の再初期化（wakeup・SAMConfigのやり直し）
+  bool softReset();
   
   // 現在の状態
   NFCStatus getStatus() const { return status; }
@@ -44,16 +92,37 @@ private:
   PN532_I2C* pn532i2c;
   PN532* nfc;
   NFCStatus status;
+  bool pollFailed;
   
-  String lastCardID;
+  NFCDetectMode detectMode;
+  bool autoPollArmed;  // InAutoPollを発行済みで応答待ち
+  unsigned long autoPollArmedUs;
+  bool cardSeen;       // この周期でカードを読んだか（連続読み取りで捨てた場合も含む）
+  bool hasEmptyCycle;
+  unsigned long lastEmptyCycleUs;  // 直前の空振り周期の開始時刻
+  NFCPollStats pollStats[2];
+  
+  char lastCardID[CARD_ID_BUF_SIZE];
   CardType lastCardType;
-  unsigned long lastSeenTime;
+  uint8_t lastTarget;  // InDataExchangeで指定するターゲット番号（Tg）
+  CardDebouncer debouncer;
+  
+  // PN532の設定（SAMConfig等）
+  bool configure();
+  
+  // 検知方式ごとの処理
+  CardType checkCardSequential();
+  CardType checkCardAutoPoll();
+  CardType parseAutoPollTarget(const uint8_t* buf, int16_t len);
+  
+  // 1周期の結果から検知までの時間を記録
+  void recordCycle(NFCDetectMode mode, CardType result, unsigned long cycleStartUs, unsigned long nowUs);
   
-  // 同じカードの連続読み取りを防ぐ
-  bool isSameCard(CardType type, const String& id);
+  // 通常のポーリング結果から接続状態を更新
+  void setPollResult(bool failed);
   
-  // バイト配列を16進数文字列に変換
-  String bytesToHexString(const uint8_t* data, uint8_t len);
+  // 読み取ったカードを記録（同じカードの連続読み取りならfalse）
+  bool acceptCard(CardType type, const uint8_t* data, uint8_t len);
 };
 
 #endif // NFC_H
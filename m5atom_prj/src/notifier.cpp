@@ -0,0 +1,137 @@
+#include "notifier.h"
+
+#define DEFAULT_QUIET_MS 10000      // 最後のイベントから10秒静かなら送信
+#define DEFAULT_MAX_DELAY_MS 30000  // 最初のイベントから最大30秒で送信
+
+Notifier::Notifier(NotifySender sender) : sender(sender), quietMs(DEFAULT_QUIET_MS),
+                                          maxDelayMs(DEFAULT_MAX_DELAY_MS), lineCount(0),
+                                          droppedLines(0), pendingPriority(NOTIFY_PRIORITY_LOW),
+                                          firstPendingTime(0), lastPendingTime(0),
+                                          eventCount(0), sendCount(0) {
+  // デフォルトポリシー：日常の解錠・施錠・開閉はまとめる、コマンド経由の解錠は即時、異常系は即時・高優先度
+  policies[NOTIFY_UNLOCK]        = { NOTIFY_PRIORITY_NORMAL, false, 0 };
+  policies[NOTIFY_REMOTE_UNLOCK] = { NOTIFY_PRIORITY_NORMAL, true,  0 };
+  policies[NOTIFY_LOCK]          = { NOTIFY_PRIORITY_NORMAL, false, 0 };
+  policies[NOTIFY_DOOR]          = { NOTIFY_PRIORITY_LOW,    false, 0 };
+  policies[NOTIFY_REJECTED]      = { NOTIFY_PRIORITY_HIGH,   true,  60000 };
+  policies[NOTIFY_NFC_ERROR]     = { NOTIFY_PRIORITY_HIGH,   true,  300000 };
+  policies[NOTIFY_SYSTEM]        = { NOTIFY_PRIORITY_NORMAL, false, 0 };
+
+  for (int i = 0; i < NOTIFY_CATEGORY_COUNT; i++) {
+    lastSentTime[i] = 0;
+    hasSent[i] = false;
+  }
+}
+
+void Notifier::setWindow(unsigned long quietMs, unsigned long maxDelayMs) {
+  this->quietMs = quietMs;
+  this->maxDelayMs = maxDelayMs;
+}
+
+void Notifier::setPolicy(NotifyCategory category, const NotifyPolicy& policy) {
+  if (category >= NOTIFY_CATEGORY_COUNT) {
+    return;
+  }
+  policies[category] = policy;
+}
+
+void Notifier::notify(NotifyCategory category, const String& message) {
+  if (category >= NOTIFY_CATEGORY_COUNT) {
+    return;
+  }
+  eventCount++;
+
+  const NotifyPolicy& policy = policies[category];
+  if (policy.immediate) {
+    unsigned long now = millis();
+    bool rateLimited = hasSent[category] && (now - lastSentTime[category] < policy.minIntervalMs);
+    if (!rateLimited) {
+      lastSentTime[category] = now;
+      hasSent[category] = true;
+      send(message, policy.priority);
+      return;
+    }
+    Serial.printf("[Notify] Category %d rate limited, deferring to digest\n", category);
+  }
+
+  enqueue(category, message);
+}
+
+void Notifier::enqueue(NotifyCategory category, const String& message) {
+  unsigned long now = millis();
+  if (lineCount == 0 && droppedLines == 0) {
+    firstPendingTime = now;
+    pendingPriority = NOTIFY_PRIORITY_LOW;
+  }
+  lastPendingTime = now;
+
+  if (policies[category].priority > pendingPriority) {
+    pendingPriority = policies[category].priority;
+  }
+
+  // 同一メッセージは回数だけ数える
+  for (uint8_t i = 0; i < lineCount; i++) {
+    if (lines[i] == message) {
+      if (lineRepeats[i] < 255) {
+        lineRepeats[i]++;
+      }
+      return;
+    }
+  }
+
+  if (lineCount < NOTIFIER_MAX_LINES) {
+    lines[lineCount] = message;
+    lineRepeats[lineCount] = 1;
+    lineCount++;
+  } else {
+    droppedLines++;
+  }
+}
+
+void Notifier::poll() {
+  if (lineCount == 0 && droppedLines == 0) {
+    return;
+  }
+
+  unsigned long now = millis();
+  if (now - lastPendingTime >= quietMs || now - firstPendingTime >= maxDelayMs) {
+    flush();
+  }
+}
+
+void Notifier::flush() {
+  if (lineCount == 0 && droppedLines == 0) {
+    return;
+  }
+
+  String digest = "";
+  for (uint8_t i = 0; i < lineCount; i++) {
+    if (i > 0) {
+      digest += "\n\n";
+    }
+    digest += lines[i];
+    if (lineRepeats[i] > 1) {
+      digest += " (x" + String(lineRepeats[i]) + ")";
+    }
+    lines[i] = "";
+  }
+  if (droppedLines > 0) {
+    digest += "\n\n他 " + String(droppedLines) + " 件";
+  }
+
+  NotifyPriority priority = pendingPriority;
+  lineCount = 0;
+  droppedLines = 0;
+  pendingPriority = NOTIFY_PRIORITY_LOW;
+
+  send(digest, priority);
+}
+
+void Notifier::send(const String& message, NotifyPriority priority) {
+  sendCount++;
+  Serial.printf("[Notify] Sending (priority %d), events=%lu sends=%lu\n",
+                (int)priority, eventCount, sendCount);
+  if (sender != nullptr) {
+    sender(message, (int)priority);
+  }
+}
@@ -0,0 +1,88 @@
+#ifndef NOTIFIER_H
+#define NOTIFIER_H
+
+#include <Arduino.h>
+
+// 通知カテゴリ
+enum NotifyCategory {
+  NOTIFY_UNLOCK,         // 解錠（NFC等、その場での操作）
+  NOTIFY_REMOTE_UNLOCK,  // 解錠（UDP・AWS IoTのコマンド経由）
+  NOTIFY_LOCK,           // 施錠
+  NOTIFY_DOOR,           // ドア開閉
+  NOTIFY_REJECTED,       // 未登録カード
+  NOTIFY_NFC_ERROR,      // NFCモジュール異常
+  NOTIFY_SYSTEM,         // その他システム通知
+  NOTIFY_CATEGORY_COUNT
+};
+
+// 通知優先度（Pushoverのpriority値に対応）
+enum NotifyPriority {
+  NOTIFY_PRIORITY_LOW = -1,
+  NOTIFY_PRIORITY_NORMAL = 0,
+  NOTIFY_PRIORITY_HIGH = 1
+};
+
+// カテゴリごとの通知ポリシー
+struct NotifyPolicy {
+  NotifyPriority priority;     // 送信時の優先度
+  bool immediate;              // trueならまとめずに即時送信
+  unsigned long minIntervalMs; // 同カテゴリの即時送信の最小間隔（超過分はまとめ通知へ回す）
+};
+
+// 実際の送信処理（Pushover等）
+typedef void (*NotifySender)(const String& message, int priority);
+
+#define NOTIFIER_MAX_LINES 8  // まとめ通知に含める最大行数
+
+// 関連するイベントを一定時間まとめて1通の通知にする
+// - 直前のイベントから quietMs 経過、または最初のイベントから maxDelayMs 経過で送信
+// - immediate なカテゴリは即時送信（ただし minIntervalMs 以内の連続分はまとめ通知へ）
+class Notifier {
+public:
+  explicit Notifier(NotifySender sender);
+
+  // まとめ時間の設定
+  void setWindow(unsigned long quietMs, unsigned long maxDelayMs);
+
+  // カテゴリごとのポリシー設定
+  void setPolicy(NotifyCategory category, const NotifyPolicy& policy);
+
+  // 通知イベントを登録
+  void notify(NotifyCategory category, const String& message);
+
+  // 保留中のまとめ通知を送信すべきか確認（loopから毎回呼ぶ）
+  void poll();
+
+  // 保留中の通知を即座に送信（再起動前など）
+  void flush();
+
+  // 統計（登録イベント数・実送信数）
+  unsigned long getEventCount() const { return eventCount; }
+  unsigned long getSendCount() const { return sendCount; }
+
+private:
+  NotifySender sender;
+  NotifyPolicy policies[NOTIFY_CATEGORY_COUNT];
+  unsigned long lastSentTime[NOTIFY_CATEGORY_COUNT];
+  bool hasSent[NOTIFY_CATEGORY_COUNT];
+
+  unsigned long quietMs;
+  unsigned long maxDelayMs;
+
+  // 保留中のまとめ通知
+  String lines[NOTIFIER_MAX_LINES];
+  uint8_t lineRepeats[NOTIFIER_MAX_LINES];
+  uint8_t lineCount;
+  unsigned int droppedLines;
+  NotifyPriority pendingPriority;
+  unsigned long firstPendingTime;
+  unsigned long lastPendingTime;
+
+  unsigned long eventCount;
+  unsigned long sendCount;
+
+  void enqueue(NotifyCategory category, const String& message);
+  void send(const String& message, NotifyPriority priority);
+};
+
+#endif // NOTIFIER_H
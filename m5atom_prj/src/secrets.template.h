@@ -1,6 +1,7 @@
 // secrets.h
 
 #include <pgmspace.h>
+#include "card_auth.h"
 
 #define SECRET
 #define THINGNAME "smartlock" // AWS IoTで作成したモノの名前
@@ -39,6 +40,16 @@ const char* ALLOWED_CARD_NAMES[] = {
     "カード1"
 };
 
+// --- NFCカード認証（任意） ---
+// AES対応カード（NTAG 424 DNA / DESFire EV2）はUIDに加えて鍵で認証する（UIDだけ複製したカードを拒否）
+// ここに載せたカードは認証必須になる。鍵は tools/card_provision で生成したカードごとの鍵
+// { "UID", 鍵番号, { 鍵16バイト } }（cardIdが空の行は無視される）
+// 使わない場合はこのブロックごと省略してよい（全カードUIDのみで照合）
+const CardAuthCredential CARD_AUTH_CREDENTIALS[] = {
+    { "", 0, { 0 } }
+};
+#define CARD_AUTH_CREDENTIAL_COUNT (int)(sizeof(CARD_AUTH_CREDENTIALS) / sizeof(CARD_AUTH_CREDENTIALS[0]))
+
 // --- Pushover Settings ---
 const char* PUSHOVER_API_TOKEN = "";
 const char* PUSHOVER_USER_KEY = "";
@@ -0,0 +1,233 @@
+#include "status_server.h"
+
+#include <errno.h>
+#include <lwip/sockets.h>
+
+#define STATUS_QUERY_MAX_LEN 32  // クエリ1行の最大長
+#define STATUS_POLL_MS 2         // イベントがない間に接続・クエリを確認する間隔
+
+StatusServer::StatusServer(uint16_t port)
+    : server(port), stateLine("{}"), stateMutex(nullptr), lineQueue(nullptr), droppedLines(0), started(false) {
+}
+
+void StatusServer::begin() {
+  stateMutex = xSemaphoreCreateMutex();
+  lineQueue = xQueueCreate(STATUS_EVENT_QUEUE_LEN, sizeof(Line));
+  server.begin();
+  server.setNoDelay(true);
+  started = true;
+  Serial.println("[Status] Server started");
+}
+
+void StatusServer::run() {
+  Line line;
+  while (true) {
+    // イベントが来ればすぐ配信、来なくてもSTATUS_POLL_MSごとに接続・クエリを処理
+    if (xQueueReceive(lineQueue, &line, pdMS_TO_TICKS(STATUS_POLL_MS)) == pdTRUE) {
+      do {
+        if (line.text[0] == '\0') {
+          String state = getState();
+          sendToAll(state.c_str(), state.length());
+        } else {
+          sendToAll(line.text, strlen(line.text));
+        }
+      } while (xQueueReceive(lineQueue, &line, 0) == pdTRUE);
+    }
+    handle();
+  }
+}
+
+String StatusServer::getState() {
+  xSemaphoreTake(stateMutex, portMAX_DELAY);
+  String state = stateLine;
+  xSemaphoreGive(stateMutex);
+  return state;
+}
+
+void StatusServer::enqueue(const char* text, size_t len) {
+  if (!started) {
+    return;
+  }
+  if (len > STATUS_LINE_MAX_LEN) {
+    Serial.printf("[Status] Line too long (%u bytes), dropped\n", (unsigned)len);
+    return;
+  }
+  // キューが一杯でも待たない（サーバタスクが詰まっていてもloopは止めない）
+  Line item;
+  memcpy(item.text, text, len);
+  item.text[len] = '\0';
+  if (xQueueSend(lineQueue, &item, 0) != pdTRUE) {
+    droppedLines++;
+    Serial.printf("[Status] Queue full, %lu line(s) dropped\n", (unsigned long)droppedLines);
+  }
+}
+
+void StatusServer::handle() {
+  acceptClients();
+
+  for (int i = 0; i < STATUS_SERVER_MAX_CLIENTS; i++) {
+    if (!clients[i]) {
+      continue;
+    }
+    if (!clients[i].connected()) {
+      dropClient(i);
+      continue;
+    }
+    readQueries(i);
+  }
+}
+
+void StatusServer::acceptClients() {
+  // 1回のhandleで受け付けるのは1接続まで（イベント配信を止めないため）
+  WiFiClient incoming = server.accept();
+  if (!incoming) {
+    return;
+  }
+
+  for (int i = 0; i < STATUS_SERVER_MAX_CLIENTS; i++) {
+    if (!clients[i] || !clients[i].connected()) {
+      clients[i].stop();
+      clients[i] = incoming;
+      clients[i].setNoDelay(true);
+      rxBuffers[i] = "";
+      Serial.printf("[Status] Client %d connected: %s\n", i, incoming.remoteIP().toString().c_str());
+      // 接続直後に現在状態を送る
+      sendLine(i, getState());
+      return;
+    }
+  }
+
+  // 空きがない場合は拒否（送れなくても待たない）
+  static const char BUSY[] = "{\"error\":\"busy\"}\n";
+  send(incoming.fd(), BUSY, sizeof(BUSY) - 1, MSG_DONTWAIT);
+  incoming.stop();
+  Serial.println("[Status] Client rejected: no free slot");
+}
+
+void StatusServer::readQueries(int index) {
+  WiFiClient& c = clients[index];
+  while (c.available() > 0) {
+    int ch = c.read();
+    if (ch < 0) {
+      break;
+    }
+    if (ch == '\n') {
+      String query = rxBuffers[index];
+      rxBuffers[index] = "";
+      handleQuery(index, query);
+      if (!clients[index]) {
+        return;
+      }
+    } else if (ch != '\r') {
+      if (rxBuffers[index].length() >= STATUS_QUERY_MAX_LEN) {
+        // 長すぎる行は破棄
+        rxBuffers[index] = "";
+      }
+      rxBuffers[index] += (char)ch;
+    }
+  }
+}
+
+void StatusServer::handleQuery(int index, String query) {
+  query.trim();
+  if (query.length() == 0) {
+    return;
+  }
+
+  if (query == "status") {
+    sendLine(index, getState());
+  } else if (query == "ping") {
+    sendLine(index, "{\"type\":\"pong\",\"uptime\":" + String(millis()) + "}");
+  } else {
+    sendLine(index, "{\"error\":\"unknown command\"}");
+  }
+}
+
+void StatusServer::setState(const String& stateJson) {
+  if (!started) {
+    stateLine = stateJson;
+    return;
+  }
+  xSemaphoreTake(stateMutex, portMAX_DELAY);
+  bool changed = stateJson != stateLine;
+  if (changed) {
+    stateLine = stateJson;
+  }
+  xSemaphoreGive(stateMutex);
+  if (changed) {
+    // 配信はサーバタスクで（イベントとの順序を保つため同じキューに合図を積む）
+    enqueue("", 0);
+  }
+}
+
+void StatusServer::broadcast(const String& line) {
+  if (line.length() == 0) {
+    return;
+  }
+  enqueue(line.c_str(), line.length());
+}
+
+void StatusServer::sendToAll(const char* line, size_t len) {
+  // 改行付きの1行を組み立てるのは1回だけ
+  String framed;
+  framed.reserve(len + 1);
+  framed += line;
+  framed += '\n';
+  for (int i = 0; i < STATUS_SERVER_MAX_CLIENTS; i++) {
+    if (clients[i]) {
+      sendRaw(i, framed.c_str(), framed.length());
+    }
+  }
+}
+
+bool StatusServer::sendLine(int index, const String& line) {
+  String framed;
+  framed.reserve(line.length() + 1);
+  framed += line;
+  framed += '\n';
+  return sendRaw(index, framed.c_str(), framed.length());
+}
+
+bool StatusServer::sendRaw(int index, const char* data, size_t len) {
+  WiFiClient& c = clients[index];
+  if (!c.connected()) {
+    dropClient(index);
+    return false;
+  }
+
+  // WiFiClient::writeは送信バッファが空くまで最大数秒ブロックするので、ソケットへ直接ノンブロッキングで送る
+  // 受信しないクライアント・消えた相手（EAGAIN・途中までしか送れない）は切断して、サーバタスクや他のクライアントを巻き込まない
+  ssize_t sent = send(c.fd(), data, len, MSG_DONTWAIT);
+  if (sent != (ssize_t)len) {
+    Serial.printf("[Status] Client %d write failed (%d), dropping\n", index, sent < 0 ? errno : (int)sent);
+    dropClient(index);
+    return false;
+  }
+  return true;
+}
+
+void StatusServer::dropClient(int index) {
+  clients[index].stop();
+  clients[index] = WiFiClient();
+  rxBuffers[index] = "";
+}
+
+void StatusServer::appendJsonString(String& out, const String& value) {
+  out += '"';
+  for (unsigned int i = 0; i < value.length(); i++) {
+    char ch = value[i];
+    if (ch == '"' || ch == '\\') {
+      out += '\\';
+      out += ch;
+    } else if (ch == '\n') {
+      out += "\\n";
+    } else if ((uint8_t)ch < 0x20) {
+      char esc[7];
+      snprintf(esc, sizeof(esc), "\\u%04x", (uint8_t)ch);
+      out += esc;
+    } else {
+      out += ch;
+    }
+  }
+  out += '"';
+}
@@ -0,0 +1,66 @@
+#ifndef STATUS_SERVER_H
+#define STATUS_SERVER_H
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#include <freertos/semphr.h>
+
+#define STATUS_SERVER_MAX_CLIENTS 4
+#define STATUS_LINE_MAX_LEN 320     // 配信する1行の最大長（改行を除く）
+#define STATUS_EVENT_QUEUE_LEN 8    // loopからサーバタスクへ渡すイベントの最大数
+
+// LAN向けの状態・イベント配信サーバ（改行区切りJSONのTCPストリーム）
+// - 接続直後に現在状態を1行送信
+// - 状態変化・イベントは全クライアントへpush
+// - "status\n" で現在状態、"ping\n" で応答を返す
+// ソケットは専用タスク（run）だけが扱う。loopはsetState/broadcastで渡すだけなので、
+// サーボ動作や通知送信でloopが止まっていても問い合わせには数msで応答する
+class StatusServer {
+public:
+  explicit StatusServer(uint16_t port);
+
+  // 待ち受け開始（WiFi接続後、タスク起動前に呼ぶ）
+  void begin();
+
+  // サーバタスクの本体（戻らない）
+  void run();
+
+  // 現在状態を更新（内容が変わった場合のみ購読者へpush）。loopから呼ぶ
+  void setState(const String& stateJson);
+
+  // イベント行を全購読者へpush（キューに積むだけでブロックしない）。loopから呼ぶ
+  void broadcast(const String& line);
+
+  // JSON文字列リテラルとして追記（"と\と制御文字をエスケープ）
+  static void appendJsonString(String& out, const String& value);
+
+private:
+  // キューの要素（空文字列は「状態が変わった」の合図）
+  struct Line {
+    char text[STATUS_LINE_MAX_LEN + 1];
+  };
+
+  WiFiServer server;
+  WiFiClient clients[STATUS_SERVER_MAX_CLIENTS];
+  String rxBuffers[STATUS_SERVER_MAX_CLIENTS];
+  String stateLine;            // stateMutexで保護（loopが書き、サーバタスクが読む）
+  SemaphoreHandle_t stateMutex;
+  QueueHandle_t lineQueue;
+  uint32_t droppedLines;
+  bool started;
+
+  String getState();
+  void enqueue(const char* text, size_t len);
+  void handle();
+  void acceptClients();
+  void readQueries(int index);
+  void handleQuery(int index, String query);
+  void sendToAll(const char* line, size_t len);
+  bool sendLine(int index, const String& line);
+  bool sendRaw(int index, const char* data, size_t len);
+  void dropClient(int index);
+};
+
+#endif // STATUS_SERVER_H
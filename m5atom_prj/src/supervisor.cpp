@@ -0,0 +1,125 @@
+#include "supervisor.h"
+
+FaultSupervisor::FaultSupervisor() : detectedReporter(nullptr), reporter(nullptr) {
+  for (int i = 0; i < FAULT_CLASS_COUNT; i++) {
+    state[i].steps = nullptr;
+    state[i].stepCount = 0;
+    state[i].failureThreshold = 1;
+    state[i].holdMs = 0;
+    state[i].consecutiveFailures = 0;
+    state[i].faulted = false;
+    state[i].faultStartTime = 0;
+    state[i].lastStepTime = 0;
+    state[i].nextStep = 0;
+    state[i].healthyStreak = false;
+    state[i].healthySince = 0;
+    state[i].faultCount = 0;
+    state[i].lastRecoveryMs = 0;
+    state[i].maxRecoveryMs = 0;
+  }
+}
+
+void FaultSupervisor::setSteps(FaultClass fault, const RecoveryStep* steps, uint8_t count,
+                               unsigned int failureThreshold, unsigned long holdMs) {
+  if (fault >= FAULT_CLASS_COUNT) {
+    return;
+  }
+  state[fault].steps = steps;
+  state[fault].stepCount = min(count, (uint8_t)SUPERVISOR_MAX_STEPS);
+  state[fault].failureThreshold = failureThreshold > 0 ? failureThreshold : 1;
+  state[fault].holdMs = holdMs;
+}
+
+void FaultSupervisor::reportHealthy(FaultClass fault) {
+  ClassState& s = state[fault];
+  s.consecutiveFailures = 0;
+  if (!s.faulted) {
+    return;
+  }
+  if (!s.healthyStreak) {
+    s.healthyStreak = true;
+    s.healthySince = millis();
+  }
+  // 一時的に通っただけでは復旧とみなさない（段階も戻さない）
+  if (millis() - s.healthySince >= s.holdMs) {
+    markRecovered(fault);
+  }
+}
+
+void FaultSupervisor::reportFailure(FaultClass fault) {
+  ClassState& s = state[fault];
+  if (s.consecutiveFailures < 0xFFFF) {
+    s.consecutiveFailures++;
+  }
+  s.healthyStreak = false;
+  if (!s.faulted && s.consecutiveFailures >= s.failureThreshold) {
+    s.faulted = true;
+    s.faultStartTime = millis();
+    s.lastStepTime = 0;
+    s.nextStep = 0;
+    s.faultCount++;
+    Serial.printf("[Supervisor] %s fault detected (%u consecutive failures)\n",
+                  faultToString(fault), s.consecutiveFailures);
+    if (detectedReporter != nullptr) {
+      detectedReporter(fault, s.consecutiveFailures);
+    }
+  }
+}
+
+void FaultSupervisor::poll(FaultClass fault) {
+  ClassState& s = state[fault];
+  if (!s.faulted || s.stepCount == 0) {
+    return;
+  }
+
+  // 正常な結果が続いている間は次のステップへ進まない（保持時間が過ぎれば復旧）
+  if (s.healthyStreak) {
+    return;
+  }
+
+  // 前のステップの効果が出るまで待つ
+  if (s.nextStep > 0 && millis() - s.lastStepTime < s.steps[s.nextStep - 1].settleMs) {
+    return;
+  }
+
+  // 最終ステップを使い切ったら最後のステップを繰り返す
+  uint8_t index = s.nextStep < s.stepCount ? s.nextStep : s.stepCount - 1;
+  const RecoveryStep& step = s.steps[index];
+
+  Serial.printf("[Supervisor] %s recovery step %d: %s\n", faultToString(fault), index + 1, step.name);
+  if (!step.action()) {
+    Serial.printf("[Supervisor] %s recovery step %d could not be executed\n", faultToString(fault), index + 1);
+  }
+  s.lastStepTime = millis();
+  if (s.nextStep < s.stepCount) {
+    s.nextStep++;
+  }
+}
+
+void FaultSupervisor::markRecovered(FaultClass fault) {
+  ClassState& s = state[fault];
+  // 直前に実行したステップで復旧したとみなす（復旧時間は正常に戻った時点まで）
+  const char* stepName = (s.nextStep > 0) ? s.steps[s.nextStep - 1].name : "none";
+  unsigned long recoveryMs = s.healthySince - s.faultStartTime;
+  s.faulted = false;
+  s.healthyStreak = false;
+  s.nextStep = 0;
+  s.lastRecoveryMs = recoveryMs;
+  if (recoveryMs > s.maxRecoveryMs) {
+    s.maxRecoveryMs = recoveryMs;
+  }
+
+  Serial.printf("[Supervisor] %s recovered in %lu ms (step: %s)\n",
+                faultToString(fault), recoveryMs, stepName);
+  if (reporter != nullptr) {
+    reporter(fault, stepName, recoveryMs);
+  }
+}
+
+const char* FaultSupervisor::faultToString(FaultClass fault) {
+  switch (fault) {
+    case FAULT_NFC:  return "NFC";
+    case FAULT_WIFI: return "WiFi";
+    default:         return "Unknown";
+  }
+}
@@ -0,0 +1,95 @@
+#ifndef SUPERVISOR_H
+#define SUPERVISOR_H
+
+#include <Arduino.h>
+
+// 障害の種類
+enum FaultClass {
+  FAULT_NFC,
+  FAULT_WIFI,
+  FAULT_CLASS_COUNT
+};
+
+// 復旧処理（戻り値：ステップを実行できたらtrue。復旧したかどうかは通常処理のreportHealthyで判定する）
+typedef bool (*RecoveryAction)();
+
+// 復旧ステップ（軽いものから順に並べる）
+struct RecoveryStep {
+  const char* name;
+  RecoveryAction action;
+  unsigned long settleMs;  // 実行後、次のステップへ進むまでの待ち時間
+};
+
+// 障害検知の報告（障害種別・連続失敗回数）。reportFailureを呼んだタスクで呼ばれる
+typedef void (*FaultDetectedReporter)(FaultClass fault, unsigned int consecutiveFailures);
+
+// 復旧完了の報告（障害種別・効いたステップ名・復旧までの時間）
+typedef void (*RecoveryReporter)(FaultClass fault, const char* stepName, unsigned long recoveryMs);
+
+#define SUPERVISOR_MAX_STEPS 6
+
+// 障害の段階的復旧
+// - 通常処理の結果を reportHealthy/reportFailure で受け取り（能動的なヘルスチェックはしない）
+// - 連続失敗が閾値を超えたら障害とみなし、poll のたびに復旧ステップを1段ずつ進める
+// - 正常な結果が保持時間続いたら復旧とみなし、障害種別ごとに復旧時間を記録して報告する
+//   （保持時間内に失敗すれば、復旧ステップは続きの段から再開する）
+// 障害種別ごとの状態は独立しているので、種別ごとに別タスクから呼び出してよい
+class FaultSupervisor {
+public:
+  FaultSupervisor();
+
+  // 復旧ステップの登録
+  void setSteps(FaultClass fault, const RecoveryStep* steps, uint8_t count, unsigned int failureThreshold,
+                unsigned long holdMs);
+
+  // 障害検知時の報告先
+  void setDetectedReporter(FaultDetectedReporter reporter) { this->detectedReporter = reporter; }
+
+  // 復旧完了時の報告先
+  void setReporter(RecoveryReporter reporter) { this->reporter = reporter; }
+
+  // 通常処理の結果を報告
+  void reportHealthy(FaultClass fault);
+  void reportFailure(FaultClass fault);
+
+  // 必要なら次の復旧ステップを実行（障害種別を処理するタスクから呼ぶ）
+  void poll(FaultClass fault);
+
+  // 障害中かどうか
+  bool isFaulted(FaultClass fault) const { return state[fault].faulted; }
+
+  // 統計
+  unsigned long getFaultCount(FaultClass fault) const { return state[fault].faultCount; }
+  unsigned long getLastRecoveryMs(FaultClass fault) const { return state[fault].lastRecoveryMs; }
+  unsigned long getMaxRecoveryMs(FaultClass fault) const { return state[fault].maxRecoveryMs; }
+
+  static const char* faultToString(FaultClass fault);
+
+private:
+  struct ClassState {
+    const RecoveryStep* steps;
+    uint8_t stepCount;
+    unsigned int failureThreshold;
+    unsigned long holdMs;  // 復旧とみなすまで正常が続く必要のある時間
+
+    volatile unsigned int consecutiveFailures;
+    volatile bool faulted;
+    unsigned long faultStartTime;
+    unsigned long lastStepTime;
+    uint8_t nextStep;
+    bool healthyStreak;        // 障害中に正常な結果が続いているか
+    unsigned long healthySince;
+
+    unsigned long faultCount;
+    unsigned long lastRecoveryMs;
+    unsigned long maxRecoveryMs;
+  };
+
+  ClassState state[FAULT_CLASS_COUNT];
+  FaultDetectedReporter detectedReporter;
+  RecoveryReporter reporter;
+
+  void markRecovered(FaultClass fault);
+};
+
+#endif // SUPERVISOR_H
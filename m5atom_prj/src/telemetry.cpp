@@ -0,0 +1,363 @@
+#include "telemetry.h"
+
+#include <string.h>
+
+// CBORのメジャータイプ
+#define CBOR_UINT  0
+#define CBOR_BYTES 2
+#define CBOR_TEXT  3
+#define CBOR_ARRAY 4
+#define CBOR_MAP   5
+#define CBOR_TAG   6
+
+#define CBOR_MAX_DEPTH 8  // 読み飛ばす入れ子の深さの上限
+
+// マップのキー
+enum TelemetryKey {
+  KEY_VERSION = 0,
+  KEY_SEQ = 1,
+  KEY_BOOT_ID = 2,
+  KEY_UNIX_MS = 3,
+  KEY_UPTIME_MS = 4,
+  KEY_TYPE = 5,
+  KEY_SOURCE = 6,
+  KEY_CARD_TYPE = 7,
+  KEY_UID = 8,
+  KEY_DURATION_MS = 9,
+  KEY_VALUE = 10
+};
+
+// --- エンコーダ ---
+
+class CborWriter {
+public:
+  CborWriter(uint8_t* buf, size_t cap) : buf(buf), cap(cap), pos(0), overflow(false) {}
+
+  void head(uint8_t major, uint64_t value) {
+    uint8_t mt = (uint8_t)(major << 5);
+    if (value < 24) {
+      put(mt | (uint8_t)value);
+    } else if (value <= 0xFF) {
+      put(mt | 24);
+      put((uint8_t)value);
+    } else if (value <= 0xFFFF) {
+      put(mt | 25);
+      putBE(value, 2);
+    } else if (value <= 0xFFFFFFFFULL) {
+      put(mt | 26);
+      putBE(value, 4);
+    } else {
+      put(mt | 27);
+      putBE(value, 8);
+    }
+  }
+
+  void uintPair(uint8_t key, uint64_t value) {
+    head(CBOR_UINT, key);
+    head(CBOR_UINT, value);
+  }
+
+  void bytesPair(uint8_t key, const uint8_t* data, size_t len) {
+    head(CBOR_UINT, key);
+    head(CBOR_BYTES, len);
+    for (size_t i = 0; i < len; i++) {
+      put(data[i]);
+    }
+  }
+
+  size_t finish() const { return overflow ? 0 : pos; }
+
+private:
+  uint8_t* buf;
+  size_t cap;
+  size_t pos;
+  bool overflow;
+
+  void put(uint8_t b) {
+    if (pos >= cap) {
+      overflow = true;
+      return;
+    }
+    buf[pos++] = b;
+  }
+
+  void putBE(uint64_t value, int bytes) {
+    for (int i = bytes - 1; i >= 0; i--) {
+      put((uint8_t)(value >> (8 * i)));
+    }
+  }
+};
+
+static uint8_t countBits(uint8_t v) {
+  uint8_t n = 0;
+  while (v) {
+    n += v & 1;
+    v >>= 1;
+  }
+  return n;
+}
+
+void telemetryInitEvent(TelemetryEvent* ev, uint8_t type) {
+  memset(ev, 0, sizeof(*ev));
+  ev->type = type;
+}
+
+static int hexDigit(char c) {
+  if (c >= '0' && c <= '9') return c - '0';
+  if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+  if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+  return -1;
+}
+
+bool telemetrySetUidHex(TelemetryEvent* ev, const char* hex) {
+  size_t len = strlen(hex);
+  if (len == 0 || len % 2 != 0 || len / 2 > TELEMETRY_UID_MAX) {
+    return false;
+  }
+  for (size_t i = 0; i < len / 2; i++) {
+    int hi = hexDigit(hex[i * 2]);
+    int lo = hexDigit(hex[i * 2 + 1]);
+    if (hi < 0 || lo < 0) {
+      return false;
+    }
+    ev->uid[i] = (uint8_t)((hi << 4) | lo);
+  }
+  ev->uidLen = (uint8_t)(len / 2);
+  ev->fields |= TF_UID;
+  return true;
+}
+
+size_t telemetryEncode(const TelemetryEvent& ev, uint8_t* buf, size_t cap) {
+  CborWriter w(buf, cap);
+
+  // 必須: バージョン・シーケンス・起動ID・経過時間・種別
+  uint8_t pairs = 5 + countBits(ev.fields & (TF_UNIX_MS | TF_SOURCE | TF_CARD_TYPE |
+                                             TF_UID | TF_DURATION_MS | TF_VALUE));
+  w.head(CBOR_MAP, pairs);
+  w.uintPair(KEY_VERSION, TELEMETRY_SCHEMA_VERSION);
+  w.uintPair(KEY_SEQ, ev.seq);
+  w.uintPair(KEY_BOOT_ID, ev.bootId);
+  if (ev.fields & TF_UNIX_MS) {
+    w.uintPair(KEY_UNIX_MS, ev.unixMs);
+  }
+  w.uintPair(KEY_UPTIME_MS, ev.uptimeMs);
+  w.uintPair(KEY_TYPE, ev.type);
+  if (ev.fields & TF_SOURCE) {
+    w.uintPair(KEY_SOURCE, ev.source);
+  }
+  if (ev.fields & TF_CARD_TYPE) {
+    w.uintPair(KEY_CARD_TYPE, ev.cardType);
+  }
+  if (ev.fields & TF_UID) {
+    w.bytesPair(KEY_UID, ev.uid, ev.uidLen);
+  }
+  if (ev.fields & TF_DURATION_MS) {
+    w.uintPair(KEY_DURATION_MS, ev.durationMs);
+  }
+  if (ev.fields & TF_VALUE) {
+    w.uintPair(KEY_VALUE, ev.value);
+  }
+  return w.finish();
+}
+
+// --- デコーダ ---
+
+class CborReader {
+public:
+  CborReader(const uint8_t* buf, size_t len) : buf(buf), len(len), pos(0), error(false) {}
+
+  // ヘッダを読む（不定長は非対応。浮動小数点・単純値は値のバイト列をvalueとして読む）
+  bool head(uint8_t* major, uint64_t* value) {
+    if (pos >= len) {
+      return fail();
+    }
+    uint8_t b = buf[pos++];
+    *major = b >> 5;
+    uint8_t info = b & 0x1F;
+    if (info < 24) {
+      *value = info;
+      return true;
+    }
+    int bytes;
+    switch (info) {
+      case 24: bytes = 1; break;
+      case 25: bytes = 2; break;
+      case 26: bytes = 4; break;
+      case 27: bytes = 8; break;
+      default: return fail();
+    }
+    if (len - pos < (size_t)bytes) {
+      return fail();
+    }
+    uint64_t v = 0;
+    for (int i = 0; i < bytes; i++) {
+      v = (v << 8) | buf[pos++];
+    }
+    *value = v;
+    return true;
+  }
+
+  const uint8_t* take(size_t n) {
+    if (len - pos < n) {
+      fail();
+      return nullptr;
+    }
+    const uint8_t* p = buf + pos;
+    pos += n;
+    return p;
+  }
+
+  // ヘッダを読んだ後の値を読み飛ばす（負の整数・配列・map・タグ・浮動小数点・bool等、全ての型）
+  bool skip(uint8_t major, uint64_t value, int depth = 0) {
+    if (depth > CBOR_MAX_DEPTH) {
+      return fail();
+    }
+    switch (major) {
+      case CBOR_BYTES:
+      case CBOR_TEXT:
+        return take((size_t)value) != nullptr;
+      case CBOR_ARRAY:
+        return skipItems(value, depth);
+      case CBOR_MAP:
+        if (value > (len - pos)) {
+          return fail();
+        }
+        return skipItems(value * 2, depth);
+      case CBOR_TAG:
+        return skipItems(1, depth);
+      default:
+        // 0/1: 整数、7: 浮動小数点・単純値（追加のバイトはheadで読み済み）
+        return true;
+    }
+  }
+
+  size_t position() const { return pos; }
+  bool failed() const { return error; }
+
+private:
+  const uint8_t* buf;
+  size_t len;
+  size_t pos;
+  bool error;
+
+  bool skipItems(uint64_t count, int depth) {
+    // 1要素は最低1バイトなので、残りより多ければ不正
+    if (count > len - pos) {
+      return fail();
+    }
+    for (uint64_t i = 0; i < count; i++) {
+      uint8_t major;
+      uint64_t value;
+      if (!head(&major, &value) || !skip(major, value, depth + 1)) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  bool fail() {
+    error = true;
+    return false;
+  }
+};
+
+size_t telemetryDecode(const uint8_t* buf, size_t len, TelemetryEvent* ev) {
+  CborReader r(buf, len);
+  telemetryInitEvent(ev, 0);
+
+  uint8_t major;
+  uint64_t pairs;
+  if (!r.head(&major, &pairs) || major != CBOR_MAP) {
+    return 0;
+  }
+
+  bool hasType = false;
+  for (uint64_t i = 0; i < pairs; i++) {
+    uint8_t keyMajor;
+    uint64_t key;
+    if (!r.head(&keyMajor, &key)) {
+      return 0;
+    }
+
+    uint8_t valMajor;
+    uint64_t val;
+    if (keyMajor != CBOR_UINT) {
+      // 整数以外のキー（将来の拡張）はキー・値ともに読み飛ばす
+      if (!r.skip(keyMajor, key) || !r.head(&valMajor, &val) || !r.skip(valMajor, val)) {
+        return 0;
+      }
+      continue;
+    }
+    if (!r.head(&valMajor, &val)) {
+      return 0;
+    }
+
+    if (valMajor == CBOR_BYTES || valMajor == CBOR_TEXT) {
+      const uint8_t* data = r.take((size_t)val);
+      if (data == nullptr) {
+        return 0;
+      }
+      if (key == KEY_UID && valMajor == CBOR_BYTES) {
+        ev->uidLen = (uint8_t)(val < TELEMETRY_UID_MAX ? val : TELEMETRY_UID_MAX);
+        memcpy(ev->uid, data, ev->uidLen);
+        ev->fields |= TF_UID;
+      }
+      continue;
+    }
+    if (valMajor != CBOR_UINT) {
+      // 整数以外の値（将来の拡張）は読み飛ばす
+      if (!r.skip(valMajor, val)) {
+        return 0;
+      }
+      continue;
+    }
+
+    switch (key) {
+      case KEY_VERSION:     break;
+      case KEY_SEQ:         ev->seq = (uint32_t)val; break;
+      case KEY_BOOT_ID:     ev->bootId = (uint32_t)val; break;
+      case KEY_UNIX_MS:     ev->unixMs = val; ev->fields |= TF_UNIX_MS; break;
+      case KEY_UPTIME_MS:   ev->uptimeMs = (uint32_t)val; break;
+      case KEY_TYPE:        ev->type = (uint8_t)val; hasType = true; break;
+      case KEY_SOURCE:      ev->source = (uint8_t)val; ev->fields |= TF_SOURCE; break;
+      case KEY_CARD_TYPE:   ev->cardType = (uint8_t)val; ev->fields |= TF_CARD_TYPE; break;
+      case KEY_DURATION_MS: ev->durationMs = (uint32_t)val; ev->fields |= TF_DURATION_MS; break;
+      case KEY_VALUE:       ev->value = (uint32_t)val; ev->fields |= TF_VALUE; break;
+      default:              break;  // 未知のキーは読み飛ばす
+    }
+  }
+
+  if (r.failed() || !hasType) {
+    return 0;
+  }
+  return r.position();
+}
+
+const char* telemetryEventTypeToString(uint8_t type) {
+  switch (type) {
+    case TEV_BOOT:             return "boot";
+    case TEV_UNLOCK:           return "unlock";
+    case TEV_LOCK:             return "lock";
+    case TEV_MODE:             return "mode";
+    case TEV_DOOR:             return "door";
+    case TEV_CARD_ACCEPTED:    return "card_accepted";
+    case TEV_CARD_REJECTED:    return "card_rejected";
+    case TEV_COMMAND:          return "command";
+    case TEV_WIFI_RECONNECTED: return "wifi_reconnected";
+    case TEV_FAULT_RECOVERED:  return "fault_recovered";
+    case TEV_MQTT_CONNECTED:   return "mqtt_connected";
+    default:                   return "unknown";
+  }
+}
+
+// --- バッチ ---
+
+bool TelemetryBatch::append(const TelemetryEvent& ev) {
+  size_t written = telemetryEncode(ev, buffer + length, TELEMETRY_BATCH_MAX - length);
+  if (written == 0) {
+    return false;
+  }
+  length += written;
+  count++;
+  return true;
+}
@@ -0,0 +1,104 @@
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// 構造化テレメトリのエンコード/デコード（CBOR）
+// Arduino非依存なので、バックエンド側でもこのファイルをそのままビルドしてデコーダとして使える
+//
+// 1イベント = CBORのmap（キーは小さな整数）。1回のpublishには複数イベントを連結して送る（CBOR Sequence）
+//   0: スキーマバージョン
+//   1: シーケンス番号（起動ごとに0から単調増加）
+//   2: 起動ID（起動ごとにランダム、シーケンス番号のリセット検出用）
+//   3: UNIX時刻[ms]（SNTP同期済みの場合のみ）
+//   4: 起動からの経過時間[ms]
+//   5: イベント種別（TelemetryEventType）
+//   6: アクセス経路（AccessSourceの値）
+//   7: カード種別（CardTypeの値）
+//   8: カードUID（バイト列）
+//   9: 所要時間[ms]
+//  10: 種別ごとの値（モード・ドア状態・障害種別など）
+
+#define TELEMETRY_SCHEMA_VERSION 1
+#define TELEMETRY_UID_MAX 10
+
+enum TelemetryEventType {
+  TEV_BOOT = 0,
+  TEV_UNLOCK = 1,           // 所要時間: カード検知（またはコマンド受信）から解錠完了まで
+  TEV_LOCK = 2,             // 所要時間: 施錠動作
+  TEV_MODE = 3,             // 値: SystemMode
+  TEV_DOOR = 4,             // 値: DoorState
+  TEV_CARD_ACCEPTED = 5,    // 値: CardAuthResult、所要時間: カード認証（認証情報があるカードのみ）
+  TEV_CARD_REJECTED = 6,    // 同上
+  TEV_COMMAND = 7,          // 値: LockCommand（access_core.h）
+  TEV_WIFI_RECONNECTED = 8,
+  TEV_FAULT_RECOVERED = 9,  // 値: FaultClass、所要時間: 復旧までの時間
+  TEV_MQTT_CONNECTED = 10
+};
+
+// フィールドの有無
+enum TelemetryField {
+  TF_UNIX_MS     = 1 << 0,
+  TF_SOURCE      = 1 << 1,
+  TF_CARD_TYPE   = 1 << 2,
+  TF_UID         = 1 << 3,
+  TF_DURATION_MS = 1 << 4,
+  TF_VALUE       = 1 << 5
+};
+
+struct TelemetryEvent {
+  uint32_t seq;
+  uint32_t bootId;
+  uint64_t unixMs;
+  uint32_t uptimeMs;
+  uint8_t type;
+  uint8_t source;
+  uint8_t cardType;
+  uint8_t uid[TELEMETRY_UID_MAX];
+  uint8_t uidLen;
+  uint32_t durationMs;
+  uint32_t value;
+  uint8_t fields;  // TelemetryFieldの組み合わせ
+};
+
+// イベントを初期化（任意フィールドはすべて無し）
+void telemetryInitEvent(TelemetryEvent* ev, uint8_t type);
+
+// 16進数文字列のUIDをイベントに設定（不正な文字列ならfalse）
+bool telemetrySetUidHex(TelemetryEvent* ev, const char* hex);
+
+// 1イベントをエンコード（戻り値：書き込んだバイト数、容量不足なら0）
+size_t telemetryEncode(const TelemetryEvent& ev, uint8_t* buf, size_t cap);
+
+// 1イベントをデコード（戻り値：消費したバイト数、不正なデータなら0）
+// 未知のキー・整数以外の値（負の整数・配列・map・浮動小数点・bool等）は読み飛ばすので、
+// 新しいスキーマのデータも古いデコーダで読める（不定長の項目のみ非対応）
+size_t telemetryDecode(const uint8_t* buf, size_t len, TelemetryEvent* ev);
+
+// イベント種別名
+const char* telemetryEventTypeToString(uint8_t type);
+
+// 複数イベントを1回のpublish用にまとめるバッファ
+#define TELEMETRY_BATCH_MAX 224  // MQTTClientのバッファ（256）からトピック名・ヘッダ分を引いた値
+
+class TelemetryBatch {
+public:
+  TelemetryBatch() : length(0), count(0) {}
+
+  // 追加（入りきらなければfalse）
+  bool append(const TelemetryEvent& ev);
+
+  const uint8_t* data() const { return buffer; }
+  size_t size() const { return length; }
+  uint16_t eventCount() const { return count; }
+  bool empty() const { return count == 0; }
+  void clear() { length = 0; count = 0; }
+
+private:
+  uint8_t buffer[TELEMETRY_BATCH_MAX];
+  size_t length;
+  uint16_t count;
+};
+
+#endif // TELEMETRY_H
@@ -0,0 +1,100 @@
+// カード認証用の鍵のプロビジョニング（PC上で実行）
+//
+// pio run -e card_provision && .pio/build/card_provision/program <マスター鍵(32桁)> <UID> [鍵番号] [システム識別子]
+//
+// マスター鍵からカードごとの鍵をAN10922の方式で多様化し（入力 = UID || システム識別子）、
+// カードに書き込む鍵と secrets.h の CARD_AUTH_CREDENTIALS に貼る行を出力する
+// 本体にはマスター鍵を置かず、登録したカードの鍵だけを持たせる（タップ時の多様化計算も不要になる）
+// カードへの鍵の書き込み（ChangeKey）はNXPのTagXplorer等で行う
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "access_core.h"
+#include "card_auth.h"
+
+#define DEFAULT_SYSTEM_ID "MySmartLock"
+
+static int hexValue(char c) {
+  if (c >= '0' && c <= '9') return c - '0';
+  if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+  if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+  return -1;
+}
+
+// 16進数文字列をバイト列に変換（戻り値：バイト数、不正なら-1）
+static int parseHex(const char* s, uint8_t* out, size_t cap) {
+  size_t len = strlen(s);
+  if (len == 0 || len % 2 != 0 || len / 2 > cap) {
+    return -1;
+  }
+  for (size_t i = 0; i < len / 2; i++) {
+    int hi = hexValue(s[i * 2]);
+    int lo = hexValue(s[i * 2 + 1]);
+    if (hi < 0 || lo < 0) {
+      return -1;
+    }
+    out[i] = (uint8_t)(hi << 4 | lo);
+  }
+  return (int)(len / 2);
+}
+
+int main(int argc, char** argv) {
+  if (argc < 3 || argc > 5) {
+    fprintf(stderr, "usage: %s MASTER_KEY_HEX UID_HEX [KEY_NO] [SYSTEM_ID]\n", argv[0]);
+    return 2;
+  }
+
+  uint8_t master[CARD_AUTH_KEY_SIZE];
+  if (parseHex(argv[1], master, sizeof(master)) != CARD_AUTH_KEY_SIZE) {
+    fprintf(stderr, "master key must be 32 hex digits\n");
+    return 2;
+  }
+
+  uint8_t uid[CARD_ID_MAX_BYTES];
+  int uidLen = parseHex(argv[2], uid, sizeof(uid));
+  if (uidLen < 4) {
+    fprintf(stderr, "UID must be 4-10 bytes in hex\n");
+    return 2;
+  }
+
+  int keyNo = argc >= 4 ? atoi(argv[3]) : 0;
+  // NTAG 424 DNAは0〜4、DESFire EV2は0〜13
+  if (keyNo < 0 || keyNo > 13) {
+    fprintf(stderr, "key number must be 0-13\n");
+    return 2;
+  }
+
+  // 多様化入力 = UID || システム識別子
+  const char* systemId = argc >= 5 ? argv[4] : DEFAULT_SYSTEM_ID;
+  uint8_t input[31];
+  size_t systemIdLen = strlen(systemId);
+  if (uidLen + systemIdLen > sizeof(input)) {
+    fprintf(stderr, "UID + system identifier must be at most %u bytes\n", (unsigned)sizeof(input));
+    return 2;
+  }
+  memcpy(input, uid, uidLen);
+  memcpy(input + uidLen, systemId, systemIdLen);
+
+  uint8_t key[CARD_AUTH_KEY_SIZE];
+  if (!cardAuthDiversifyKey(master, input, uidLen + systemIdLen, key)) {
+    fprintf(stderr, "key diversification failed\n");
+    return 1;
+  }
+
+  // ALLOWED_CARD_IDSと同じ形式（大文字16進数）
+  char cardId[CARD_ID_BUF_SIZE];
+  cardBytesToHex(uid, (uint8_t)uidLen, cardId);
+
+  printf("Card key (key %d of the NDEF application): ", keyNo);
+  for (int i = 0; i < CARD_AUTH_KEY_SIZE; i++) {
+    printf("%02X", key[i]);
+  }
+  printf("\n\nsecrets.h (CARD_AUTH_CREDENTIALS):\n    { \"%s\", %d, { ", cardId, keyNo);
+  for (int i = 0; i < CARD_AUTH_KEY_SIZE; i++) {
+    printf("0x%02X%s", key[i], i + 1 < CARD_AUTH_KEY_SIZE ? ", " : "");
+  }
+  printf(" } },\n");
+  return 0;
+}
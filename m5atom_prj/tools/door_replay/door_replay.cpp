@@ -0,0 +1,183 @@
+// 記録したVL53L0Xの測定値列をDoorDetectorに再生して検証する（PC上で実行）
+//
+// pio run -e door_replay && .pio/build/door_replay/program tools/door_replay/samples/*.csv
+//   [--close MM] [--open MM] [--alpha A] [--median N] [--close-samples N] [--close-ms MS]
+//
+// 入力はmain.cppのDOOR_SAMPLE_LOGが出力する行（"[DOOR] ms,range,status,signal,filtered,state"）
+// 先頭の "[DOOR] " はあってもなくてもよい。filtered・stateの列は記録時の値なので再生では使わない
+// コメント行で正解ラベルを付ける:
+//   # initial: OPEN|CLOSE        記録開始時のドア状態
+//   # event: <ms> OPEN|CLOSE     実際にドアが開いた/閉まった時刻
+//   # max_latency_ms: <ms>       実際の開閉から検知までの許容時間
+// ラベルのない遷移（誤検知）・検知されなかったラベル・許容時間超過があれば失敗（終了コード1）
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "door_detector.h"
+
+#define MAX_EVENTS 32
+#define DEFAULT_MAX_LATENCY_MS 500
+
+struct LabeledEvent {
+  unsigned long ms;
+  DoorState state;
+};
+
+static const char* stateName(DoorState s) {
+  return s == DOOR_CLOSE ? "CLOSE" : "OPEN";
+}
+
+static bool parseState(const char* s, DoorState* out) {
+  if (strncmp(s, "OPEN", 4) == 0) {
+    *out = DOOR_OPEN;
+    return true;
+  }
+  if (strncmp(s, "CLOSE", 5) == 0) {
+    *out = DOOR_CLOSE;
+    return true;
+  }
+  return false;
+}
+
+// 1ファイルを再生（戻り値：合格ならtrue）
+static bool replayFile(const char* path, const DoorDetectorConfig& config) {
+  FILE* f = fopen(path, "r");
+  if (f == nullptr) {
+    printf("%s: cannot open\n", path);
+    return false;
+  }
+
+  const char* name = strrchr(path, '/');
+  name = name ? name + 1 : path;
+
+  DoorDetector detector(config);
+  DoorState initial = DOOR_OPEN;
+  LabeledEvent events[MAX_EVENTS];
+  int eventCount = 0;
+  unsigned long maxLatencyMs = DEFAULT_MAX_LATENCY_MS;
+  bool started = false;
+
+  int nextEvent = 0;
+  int falseEdges = 0;
+  int samples = 0;
+  unsigned long worstLatency = 0;
+  bool ok = true;
+
+  char line[160];
+  while (fgets(line, sizeof(line), f) != nullptr) {
+    if (line[0] == '#') {
+      // ラベル（測定値より前に書く）
+      const char* value;
+      if ((value = strstr(line, "initial:")) != nullptr) {
+        value += 8;
+        while (*value == ' ') value++;
+        parseState(value, &initial);
+      } else if ((value = strstr(line, "max_latency_ms:")) != nullptr) {
+        maxLatencyMs = strtoul(value + 15, nullptr, 10);
+      } else if ((value = strstr(line, "event:")) != nullptr && eventCount < MAX_EVENTS) {
+        char* end;
+        events[eventCount].ms = strtoul(value + 6, &end, 10);
+        while (*end == ' ') end++;
+        if (parseState(end, &events[eventCount].state)) {
+          eventCount++;
+        }
+      }
+      continue;
+    }
+
+    const char* p = line;
+    if (strncmp(p, "[DOOR] ", 7) == 0) {
+      p += 7;
+    }
+    unsigned long ms;
+    unsigned int range, status;
+    float signal;
+    if (sscanf(p, "%lu,%u,%u,%f", &ms, &range, &status, &signal) != 4) {
+      continue;
+    }
+
+    if (!started) {
+      detector.reset(initial);
+      started = true;
+    }
+    samples++;
+
+    if (!detector.update(ms, (uint16_t)range, (uint8_t)status, signal)) {
+      continue;
+    }
+
+    // 検知した遷移を次の正解ラベルと突き合わせる
+    DoorState detected = detector.getState();
+    if (nextEvent < eventCount && events[nextEvent].state == detected && events[nextEvent].ms <= ms) {
+      unsigned long latency = ms - events[nextEvent].ms;
+      if (latency > worstLatency) {
+        worstLatency = latency;
+      }
+      if (latency > maxLatencyMs) {
+        printf("%s: %s at %lu detected after %lu ms (max %lu)\n", name, stateName(detected),
+               events[nextEvent].ms, latency, maxLatencyMs);
+        ok = false;
+      }
+      nextEvent++;
+    } else {
+      printf("%s: false edge to %s at %lu ms\n", name, stateName(detected), ms);
+      falseEdges++;
+      ok = false;
+    }
+  }
+  fclose(f);
+
+  for (int i = nextEvent; i < eventCount; i++) {
+    printf("%s: %s at %lu was never detected\n", name, stateName(events[i].state), events[i].ms);
+    ok = false;
+  }
+
+  printf("%-28s %4d samples  %d/%d edges  worst latency %4lu ms  false edges %d  rejected %lu  %s\n",
+         name, samples, nextEvent, eventCount, worstLatency, falseEdges, detector.getRejectedCount(),
+         ok ? "OK" : "FAIL");
+  return ok;
+}
+
+int main(int argc, char** argv) {
+  DoorDetectorConfig config = DoorDetector::defaultConfig();
+  const char* files[64];
+  int fileCount = 0;
+
+  for (int i = 1; i < argc; i++) {
+    bool hasValue = i + 1 < argc;
+    if (strcmp(argv[i], "--close") == 0 && hasValue) {
+      config.closeThresholdMm = (uint16_t)atoi(argv[++i]);
+    } else if (strcmp(argv[i], "--open") == 0 && hasValue) {
+      config.openThresholdMm = (uint16_t)atoi(argv[++i]);
+    } else if (strcmp(argv[i], "--alpha") == 0 && hasValue) {
+      config.emaAlpha = (float)atof(argv[++i]);
+    } else if (strcmp(argv[i], "--median") == 0 && hasValue) {
+      config.medianWindow = (uint8_t)atoi(argv[++i]);
+    } else if (strcmp(argv[i], "--close-samples") == 0 && hasValue) {
+      config.closeConfirmSamples = (uint8_t)atoi(argv[++i]);
+    } else if (strcmp(argv[i], "--close-ms") == 0 && hasValue) {
+      config.closeConfirmMs = strtoul(argv[++i], nullptr, 10);
+    } else if (argv[i][0] != '-' && fileCount < 64) {
+      files[fileCount++] = argv[i];
+    } else {
+      fprintf(stderr, "usage: %s [--close MM] [--open MM] [--alpha A] [--median N] "
+              "[--close-samples N] [--close-ms MS] FILE...\n", argv[0]);
+      return 2;
+    }
+  }
+  if (fileCount == 0) {
+    fprintf(stderr, "no sample files\n");
+    return 2;
+  }
+
+  int failed = 0;
+  for (int i = 0; i < fileCount; i++) {
+    if (!replayFile(files[i], config)) {
+      failed++;
+    }
+  }
+  printf("\n%d/%d sequence(s) passed\n", fileCount - failed, fileCount);
+  return failed > 0 ? 1 : 0;
+}
@@ -0,0 +1,287 @@
+// smartlock/telemetry のCBORバッチをデコードして表示する（PC上で実行）
+//
+// pio run -e telemetry_decode && .pio/build/telemetry_decode/program <FILE>   受信したpayload（バイナリ）
+//                                .pio/build/telemetry_decode/program --hex <16進数>
+//                                .pio/build/telemetry_decode/program --check  デコーダの自己検査
+//
+// 例: mosquitto_sub ... -t smartlock/telemetry -C 1 > batch.bin && program batch.bin
+// --check はエンコード→デコードの往復・途中で切れたデータ・未知のキー/型を含むデータを検査する（誤りがあれば終了コード1）
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "telemetry.h"
+
+#define MAX_PAYLOAD 4096
+
+static int hexValue(char c) {
+  if (c >= '0' && c <= '9') return c - '0';
+  if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+  if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+  return -1;
+}
+
+// 16進数文字列をバイト列に変換（空白は無視、戻り値：バイト数、不正なら-1）
+static int parseHex(const char* s, uint8_t* out, size_t cap) {
+  size_t n = 0;
+  int hi = -1;
+  for (; *s != '\0'; s++) {
+    if (*s == ' ' || *s == '\n' || *s == '\r' || *s == '\t') {
+      continue;
+    }
+    int v = hexValue(*s);
+    if (v < 0) {
+      return -1;
+    }
+    if (hi < 0) {
+      hi = v;
+      continue;
+    }
+    if (n >= cap) {
+      return -1;
+    }
+    out[n++] = (uint8_t)(hi << 4 | v);
+    hi = -1;
+  }
+  return hi < 0 ? (int)n : -1;
+}
+
+static void printEvent(const TelemetryEvent& ev) {
+  printf("seq=%lu boot=%08lx type=%s uptime=%lums", (unsigned long)ev.seq, (unsigned long)ev.bootId,
+         telemetryEventTypeToString(ev.type), (unsigned long)ev.uptimeMs);
+  if (ev.fields & TF_UNIX_MS) {
+    printf(" unix=%llums", (unsigned long long)ev.unixMs);
+  }
+  if (ev.fields & TF_SOURCE) {
+    printf(" source=%u", ev.source);
+  }
+  if (ev.fields & TF_CARD_TYPE) {
+    printf(" cardType=%u", ev.cardType);
+  }
+  if (ev.fields & TF_UID) {
+    printf(" uid=");
+    for (uint8_t i = 0; i < ev.uidLen; i++) {
+      printf("%02X", ev.uid[i]);
+    }
+  }
+  if (ev.fields & TF_DURATION_MS) {
+    printf(" duration=%lums", (unsigned long)ev.durationMs);
+  }
+  if (ev.fields & TF_VALUE) {
+    printf(" value=%lu", (unsigned long)ev.value);
+  }
+  printf("\n");
+}
+
+// バッチ（CBOR Sequence）を先頭から順にデコードして表示（戻り値：最後まで読めたらtrue）
+static bool decodeBatch(const uint8_t* data, size_t len) {
+  size_t pos = 0;
+  int count = 0;
+  while (pos < len) {
+    TelemetryEvent ev;
+    size_t used = telemetryDecode(data + pos, len - pos, &ev);
+    if (used == 0) {
+      printf("invalid event at offset %lu\n", (unsigned long)pos);
+      return false;
+    }
+    printEvent(ev);
+    pos += used;
+    count++;
+  }
+  printf("%d event(s), %lu bytes\n", count, (unsigned long)len);
+  return true;
+}
+
+// --- 自己検査 ---
+
+static int wrong = 0;
+
+static void verdict(const char* name, bool ok) {
+  printf("  %-28s %s\n", name, ok ? "OK" : "WRONG");
+  if (!ok) {
+    wrong++;
+  }
+}
+
+static bool sameEvent(const TelemetryEvent& a, const TelemetryEvent& b) {
+  return a.seq == b.seq && a.bootId == b.bootId && a.uptimeMs == b.uptimeMs && a.type == b.type &&
+         a.fields == b.fields &&
+         (!(a.fields & TF_UNIX_MS) || a.unixMs == b.unixMs) &&
+         (!(a.fields & TF_SOURCE) || a.source == b.source) &&
+         (!(a.fields & TF_CARD_TYPE) || a.cardType == b.cardType) &&
+         (!(a.fields & TF_UID) || (a.uidLen == b.uidLen && memcmp(a.uid, b.uid, a.uidLen) == 0)) &&
+         (!(a.fields & TF_DURATION_MS) || a.durationMs == b.durationMs) &&
+         (!(a.fields & TF_VALUE) || a.value == b.value);
+}
+
+// 全フィールドあり・必須のみ・境界値のイベント
+static int makeSampleEvents(TelemetryEvent* events) {
+  telemetryInitEvent(&events[0], TEV_CARD_ACCEPTED);
+  events[0].seq = 42;
+  events[0].bootId = 0xDEADBEEF;
+  events[0].uptimeMs = 123456;
+  events[0].unixMs = 1735689600123ULL;
+  events[0].source = 0;
+  events[0].cardType = 2;
+  events[0].durationMs = 38;
+  events[0].value = 0;
+  events[0].fields |= TF_UNIX_MS | TF_SOURCE | TF_CARD_TYPE | TF_DURATION_MS | TF_VALUE;
+  telemetrySetUidHex(&events[0], "04A1B2C3D4E5F6");
+
+  telemetryInitEvent(&events[1], TEV_BOOT);
+  events[1].seq = 0;
+  events[1].bootId = 1;
+
+  telemetryInitEvent(&events[2], TEV_FAULT_RECOVERED);
+  events[2].seq = 0xFFFFFFFF;
+  events[2].bootId = 0xFFFFFFFF;
+  events[2].uptimeMs = 0xFFFFFFFF;
+  events[2].unixMs = 0xFFFFFFFFFFFFFFFFULL;
+  events[2].durationMs = 0xFFFFFFFF;
+  events[2].value = 0xFFFFFFFF;
+  events[2].fields |= TF_UNIX_MS | TF_DURATION_MS | TF_VALUE;
+  telemetrySetUidHex(&events[2], "00112233445566778899");
+  return 3;
+}
+
+static void checkRoundTrip() {
+  TelemetryEvent events[3];
+  int n = makeSampleEvents(events);
+  TelemetryBatch batch;
+  bool ok = true;
+  for (int i = 0; i < n; i++) {
+    ok = ok && batch.append(events[i]);
+  }
+  size_t pos = 0;
+  for (int i = 0; i < n && ok; i++) {
+    TelemetryEvent decoded;
+    size_t used = telemetryDecode(batch.data() + pos, batch.size() - pos, &decoded);
+    ok = used > 0 && sameEvent(events[i], decoded);
+    pos += used;
+  }
+  verdict("round_trip/batch", ok && pos == batch.size());
+}
+
+static void checkTruncation() {
+  TelemetryEvent events[3];
+  makeSampleEvents(events);
+  uint8_t buf[64];
+  size_t len = telemetryEncode(events[0], buf, sizeof(buf));
+  // 途中で切れたデータはどの位置でも不正として扱う（範囲外を読まない）
+  bool ok = len > 0;
+  for (size_t cut = 0; cut < len && ok; cut++) {
+    TelemetryEvent decoded;
+    ok = telemetryDecode(buf, cut, &decoded) == 0;
+  }
+  verdict("truncated/every_length", ok);
+}
+
+static bool decodesTo(const uint8_t* data, size_t len, size_t expectedUsed, TelemetryEvent* ev) {
+  return telemetryDecode(data, len, ev) == expectedUsed;
+}
+
+static void checkUnknownKeys() {
+  // 新しいスキーマのイベント（未知のキー・整数以外の値・整数以外のキー）の後に通常のイベントが続く
+  static const uint8_t data[] = {
+    0xB0,                                      // map(16)
+    0x00, 0x01,                                // 0: version 1
+    0x01, 0x05,                                // 1: seq 5
+    0x02, 0x1A, 0x00, 0x01, 0xE2, 0x40,        // 2: bootId 123456
+    0x04, 0x19, 0x03, 0xE8,                    // 4: uptime 1000
+    0x05, 0x04,                                // 5: type door
+    0x18, 0x63, 0x18, 0x2A,                    // 99: 42
+    0x0B, 0x63, 'a', 'b', 'c',                 // 11: "abc"
+    0x0C, 0x82, 0x01, 0x82, 0x02, 0x03,        // 12: [1, [2, 3]]
+    0x0D, 0xA1, 0x01, 0x02,                    // 13: {1: 2}
+    0x0E, 0xC1, 0x18, 0x7B,                    // 14: tag1(123)
+    0x0F, 0xFB, 0x40, 0x09, 0x21, 0xFB, 0x54, 0x44, 0x2D, 0x18,  // 15: 3.14159...
+    0x10, 0x38, 0x63,                          // 16: -100
+    0x11, 0xF5,                                // 17: true
+    0x61, 'x', 0x42, 0x01, 0x02,               // "x": h'0102'
+    0x06, 0x63, 'n', 'f', 'c',                 // 6（既知のキー）: 整数以外なら無視
+    0x0A, 0x01,                                // 10: value 1
+    // 続くイベント: {0:1, 1:6, 2:1, 4:0, 5:0}
+    0xA5, 0x00, 0x01, 0x01, 0x06, 0x02, 0x01, 0x04, 0x00, 0x05, 0x00
+  };
+  const size_t firstLen = sizeof(data) - 11;
+
+  TelemetryEvent ev;
+  bool ok = decodesTo(data, sizeof(data), firstLen, &ev) && ev.type == TEV_DOOR && ev.seq == 5 &&
+            ev.bootId == 123456 && ev.uptimeMs == 1000 && ev.value == 1 && ev.fields == TF_VALUE;
+  verdict("unknown_keys/skipped", ok);
+
+  TelemetryEvent next;
+  ok = decodesTo(data + firstLen, sizeof(data) - firstLen, 11, &next) && next.seq == 6 && next.type == TEV_BOOT;
+  verdict("unknown_keys/next_event", ok);
+}
+
+static void checkRejected() {
+  TelemetryEvent ev;
+
+  // 不定長の配列は非対応
+  static const uint8_t indefinite[] = { 0xA2, 0x05, 0x00, 0x0C, 0x9F, 0x01, 0xFF };
+  verdict("rejected/indefinite_length", telemetryDecode(indefinite, sizeof(indefinite), &ev) == 0);
+
+  // 入れ子が深すぎる
+  uint8_t deep[32];
+  size_t n = 0;
+  deep[n++] = 0xA2;
+  deep[n++] = 0x05;
+  deep[n++] = 0x00;
+  deep[n++] = 0x0C;
+  for (int i = 0; i < 20; i++) {
+    deep[n++] = 0x81;
+  }
+  deep[n++] = 0x01;
+  verdict("rejected/too_deep", telemetryDecode(deep, n, &ev) == 0);
+
+  // 要素数が残りのバイト数を超える
+  static const uint8_t hugeArray[] = { 0xA2, 0x05, 0x00, 0x0C, 0x9B, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF };
+  verdict("rejected/huge_count", telemetryDecode(hugeArray, sizeof(hugeArray), &ev) == 0);
+
+  // mapでない・種別がない
+  static const uint8_t notMap[] = { 0x82, 0x05, 0x00 };
+  verdict("rejected/not_a_map", telemetryDecode(notMap, sizeof(notMap), &ev) == 0);
+  static const uint8_t noType[] = { 0xA1, 0x01, 0x05 };
+  verdict("rejected/missing_type", telemetryDecode(noType, sizeof(noType), &ev) == 0);
+}
+
+static int runChecks() {
+  printf("[Check] telemetry decoder\n");
+  checkRoundTrip();
+  checkTruncation();
+  checkUnknownKeys();
+  checkRejected();
+  printf("[Check] %d wrong result(s)\n", wrong);
+  return wrong > 0 ? 1 : 0;
+}
+
+int main(int argc, char** argv) {
+  static uint8_t payload[MAX_PAYLOAD];
+
+  if (argc == 2 && strcmp(argv[1], "--check") == 0) {
+    return runChecks();
+  }
+  if (argc == 3 && strcmp(argv[1], "--hex") == 0) {
+    int n = parseHex(argv[2], payload, sizeof(payload));
+    if (n < 0) {
+      fprintf(stderr, "invalid hex\n");
+      return 2;
+    }
+    return decodeBatch(payload, (size_t)n) ? 0 : 1;
+  }
+  if (argc == 2 && argv[1][0] != '-') {
+    FILE* f = fopen(argv[1], "rb");
+    if (f == nullptr) {
+      fprintf(stderr, "cannot open: %s\n", argv[1]);
+      return 2;
+    }
+    size_t n = fread(payload, 1, sizeof(payload), f);
+    fclose(f);
+    return decodeBatch(payload, n) ? 0 : 1;
+  }
+
+  fprintf(stderr, "usage: %s FILE | --hex HEX | --check\n", argv[0]);
+  return 2;
+}